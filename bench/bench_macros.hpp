@@ -0,0 +1,34 @@
+/**
+ * @file bench_macros.hpp
+ *
+ * Helpers for the latency benchmarks.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+/**
+ * @brief Measure the latency of a single call of f, in nanoseconds
+ *
+ * Prints the median, 99th percentile and maximum over all samples.
+ */
+template<typename F>
+void benchLatency(const char *name, F f, size_t warmup, size_t samples, double ns[])
+{
+    for (size_t i = 0; i < warmup; i++) {
+        f(i);
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f(i);
+        auto end = std::chrono::steady_clock::now();
+        ns[i] = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    std::sort(ns, ns + samples);
+    printf("%-40s median %8.0f ns\tp99 %8.0f ns\tmax %8.0f ns\n", name,
+           ns[samples / 2], ns[samples * 99 / 100], ns[samples - 1]);
+}
@@ -0,0 +1,45 @@
+#include "bench_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/BiquadFilterBank.hpp"
+
+using namespace ifl_control;
+
+static const size_t warmup = 1000;
+static const size_t samples = 100000;
+static double ns[samples];
+
+int main()
+{
+    // 4 axes and 8 actuators
+    const size_t C = 12;
+
+    BiquadFilterBank<C, 2> bank;
+    bank.setLowPass(4000.0f, 40.0f);
+
+    BiquadFilterBank<1, 2> single[C];
+    for (size_t c = 0; c < C; c++) {
+        single[c].setLowPass(4000.0f, 40.0f);
+    }
+
+    float x[C] = {};
+    float y[C] = {};
+
+    benchLatency("filter bank 12 channels", [&](size_t i) {
+        for (size_t c = 0; c < C; c++) {
+            x[c] = static_cast<float>((i + c) % 7);
+        }
+        bank.update(x, y);
+    }, warmup, samples, ns);
+
+    benchLatency("12 single channel filters", [&](size_t i) {
+        for (size_t c = 0; c < C; c++) {
+            x[c] = static_cast<float>((i + c) % 7);
+        }
+        for (size_t c = 0; c < C; c++) {
+            single[c].update(&x[c], &y[c]);
+        }
+    }, warmup, samples, ns);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/HorizonAllocator.hpp"
+
+using namespace ifl_control;
+
+static const size_t warmup = 100;
+static const size_t samples = 10000;
+static double ns[samples];
+
+/**
+ * Rate limited roll and pitch doublets, the cost per iteration should grow
+ * linearly with the horizon.
+ */
+template<size_t H>
+void benchHorizon(const char *name)
+{
+    float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                 17.0f, -17.0f, 17.0f, -17.0f,
+                 0.7f, 0.7f, -0.7f, -0.7f,
+                 -1.2f, -1.2f, -1.2f, -1.2f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float rate[] = {0.1f, 0.1f, 0.1f, 0.1f};
+    float Wr[] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    static HorizonAllocator<4, 4, H> horizon;
+    horizon.setActuatorEffectiveness(B);
+    horizon.setOutputWeights(Wv);
+    horizon.setActuatorUpperLimit(u_up);
+    horizon.setActuatorLowerLimit(u_lo);
+    horizon.setActuatorRateLimit(rate);
+    horizon.setRateWeights(Wr);
+
+    static float v[H*4];
+    static float u[H*4];
+    float u_prev[4] = {};
+
+    benchLatency(name, [&](size_t i) {
+        for (size_t t = 0; t < H; t++) {
+            const float s = ((i + t) / 8) % 2 == 0 ? 1.0f : -1.0f;
+            v[t*4] = 30.0f * s;
+            v[t*4 + 1] = -20.0f * s;
+        }
+        horizon.calculateActuatorCommands(v, u_prev, u, 1);
+    }, warmup, samples, ns);
+}
+
+int main()
+{
+    // a single iteration, to show the scaling of the block recursion
+    benchHorizon<5>("horizon 4x4, H = 5, one iteration");
+    benchHorizon<10>("horizon 4x4, H = 10, one iteration");
+    benchHorizon<20>("horizon 4x4, H = 20, one iteration");
+    benchHorizon<40>("horizon 4x4, H = 40, one iteration");
+
+    return 0;
+}
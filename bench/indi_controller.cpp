@@ -0,0 +1,73 @@
+#include "bench_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/IndiController.hpp"
+
+using namespace ifl_control;
+
+static const size_t warmup = 1000;
+static const size_t samples = 100000;
+static double ns[samples];
+
+int main()
+{
+    float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                 17.0f, -17.0f, 17.0f, -17.0f,
+                 0.7f, 0.7f, -0.7f, -0.7f,
+                 -1.2f, -1.2f, -1.2f, -1.2f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+
+    float u_f[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+    float u[4] = {};
+
+    // small errors, solution is unconstrained
+    benchLatency("indi 4x4 unconstrained", [&](size_t i) {
+        float e = 0.1f * static_cast<float>(i % 16);
+        float accel_error[4] = {e, -e, 0.5f * e, 0.0f};
+        indi.update(accel_error, u_f, u, 10);
+    }, warmup, samples, ns);
+
+    // large errors, several actuators saturate
+    benchLatency("indi 4x4 saturated", [&](size_t i) {
+        float e = 10.0f * static_cast<float>(i % 16);
+        float accel_error[4] = {e, -e, 5.0f, 0.0f};
+        indi.update(accel_error, u_f, u, 10);
+    }, warmup, samples, ns);
+
+    // closed loop, the output is fed back as the filtered actuator state
+    benchLatency("indi 4x4 closed loop", [&](size_t i) {
+        float e = 20.0f * static_cast<float>(static_cast<int>(i % 32) - 16);
+        float accel_error[4] = {e, 0.5f * e, 1.0f, 0.0f};
+        indi.update(accel_error, u_f, u, 10);
+        for (size_t j = 0; j < 4; j++) {
+            u_f[j] += 0.2f * (u[j] - u_f[j]);
+        }
+    }, warmup, samples, ns);
+
+    // raw measurements through the synchronization filter
+    indi.setFilterLowPass(4000.0f, 40.0f);
+    float accel_ref[4] = {};
+    float accel[4] = {};
+    float u_meas[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+    indi.resetFilter(accel, u_meas);
+    benchLatency("indi 4x4 filtered", [&](size_t i) {
+        float e = 20.0f * static_cast<float>(static_cast<int>(i % 32) - 16);
+        accel_ref[0] = e;
+        accel_ref[1] = 0.5f * e;
+        indi.update(accel_ref, accel, u_meas, u, 10);
+        for (size_t j = 0; j < 4; j++) {
+            u_meas[j] += 0.2f * (u[j] - u_meas[j]);
+        }
+    }, warmup, samples, ns);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "bench_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/ActiveSetAlgorithm.hpp"
+
+using namespace ifl_control;
+
+static const size_t warmup = 100;
+static const size_t samples = 10000;
+static double ns[samples];
+
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg()
+{
+    lcg_state = lcg_state * 1664525u + 1013904223u;
+    return lcg_state >> 8;
+}
+
+/**
+ * Random effectiveness with half of the entries zero, solved once with dense
+ * and once with sparse columns. Both see the same sequence of problems.
+ */
+template<size_t M, size_t N>
+void benchSparse(const char *name, bool sparse)
+{
+    lcg_state = 1;
+    float B[M*N];
+    for (size_t l = 0; l < M*N; l++) {
+        const float value = static_cast<float>(lcg() % 2001u) / 1000.0f - 1.0f;
+        B[l] = lcg() % 2u == 0 ? value : 0.0f;
+    }
+    float Wv[M];
+    for (size_t i = 0; i < M; i++) {
+        Wv[i] = 1.0f;
+    }
+    float u_up[N];
+    float u_lo[N];
+    for (size_t j = 0; j < N; j++) {
+        u_up[j] = 1.0f;
+        u_lo[j] = -1.0f;
+    }
+
+    static ActiveSetAlgorithm<M, N> asa;
+    asa.setActuatorEffectiveness(B);
+    asa.setOutputWeights(Wv);
+    asa.setActuatorUpperLimit(u_up);
+    asa.setActuatorLowerLimit(u_lo);
+    asa.setSparseColumns(sparse);
+
+    static float v[samples + warmup][M];
+    for (size_t s = 0; s < samples + warmup; s++) {
+        for (size_t i = 0; i < M; i++) {
+            v[s][i] = static_cast<float>(lcg() % 4001u) / 1000.0f - 2.0f;
+        }
+    }
+
+    float u[N];
+    benchLatency(name, [&](size_t i) {
+        for (size_t j = 0; j < N; j++) {
+            u[j] = 0.0f;
+        }
+        asa.calculateActuatorCommands(v[i % (samples + warmup)], u, 2*N);
+    }, warmup, samples, ns);
+}
+
+int main()
+{
+    benchSparse<6, 12>("allocate 6x12, 50% zeros, dense", false);
+    benchSparse<6, 12>("allocate 6x12, 50% zeros, sparse", true);
+    benchSparse<12, 12>("allocate 12x12, 50% zeros, dense", false);
+    benchSparse<12, 12>("allocate 12x12, 50% zeros, sparse", true);
+
+    return 0;
+}
@@ -5,50 +5,77 @@
  *
  * More explanation to come.
  *
+ * The problem is split in an AllocatorConfiguration, which is only read
+ * during an allocation, and an ActiveSetWorkspace with the state of one
+ * allocation. Many workspaces can share one configuration. The
+ * ActiveSetAlgorithm class combines one of each.
+ *
  * @author Bart Slinger <bartslinger@gmail.com>
  */
 
 #pragma once
 
-#include "LeastSquaresSolver.hpp"
+#include "AllocatorConfiguration.hpp"
 
 namespace ifl_control {
 
 /**
- * @brief The ActiveSetAlgorithm class
+ * @brief The ActiveSetWorkspace class
  *
- * The algorithm gets initialized with a certain effectiveness matrix A.
- * A weighting matrix can be supplied to favor certain outputs over others.
- * Inputs for a calculation are the desired outputs, and the upper and lower
- * bounds available from the actuator.
- * The output is a vector containing the control commands.
+ * Holds the actuator bounds and all intermediate results of an allocation,
+ * so calculateActuatorCommands() keeps no arrays on the stack. Its stack use
+ * does not grow with M and N. The deepest call chain goes through the QR
+ * decomposition and takes 512 bytes on x86-64 with GCC -O2, measured with
+ * -fstack-usage and inlining disabled.
+ *
+ * Memory use, in bytes before padding, with D = max(M, N) and K = min(M, N),
+ * for a 64 bit target:
+ *
+ *   4*M*N + 4*M + 8*K + 25*N + 8*D + 2 + 10 words
+ *
+ * That is the free columns A_f (M*N floats), b (M floats), tau (2*K floats),
+ * the bounds and the perturbation (N floats each), the pattern of A_f
+ * (N 32 bit words), its column permutation (N words), the working set
+ * (N bytes), the residual, which is solved in place, and the solver working
+ * space (D floats each), the solver state (9 words), the iteration count and
+ * two flags.
+ *
+ * The subproblems are solved with a complete orthogonal decomposition, based
+ * on a column-pivoted QR decomposition. The perturbation is the minimum norm
+ * solution, so free actuators with (nearly) collinear columns share the
+ * effort equally, and degenerate configurations and more actuators than
+ * outputs are handled without extra iterations.
+ *
+ * Effectiveness matrices often contain many structural zeros. When sparse
+ * columns are enabled, the zero pattern of the configuration is used to skip
+ * the zero rows in the residual and QR kernels, which walk only the set bits
+ * of the pattern. This requires M to be at most
+ * LeastSquaresSolver::MAX_PATTERN_ROWS.
  */
 template<size_t M, size_t N>
-class ActiveSetAlgorithm
+class ActiveSetWorkspace
 {
 public:
-    ActiveSetAlgorithm() :
-        _B{},
-        _Wv{}
+    ActiveSetWorkspace() :
+        _u_up{},
+        _u_lo{},
+        _A_f{},
+        _A_f_pattern{},
+        _b{},
+        _p{},
+        _d{},
+        _tau{},
+        _w{},
+        _perm{}
     {
 
     }
 
-    int setActuatorEffectiveness(const float B_row_major[]) {
-        // Is provided row-major. Convert to column major
-        for (size_t i = 0; i < M*N; i++) {
-            _B[i] = B_row_major[(i%M)*N + (i/M)];
-            //printf("%lu\t%1.2f\n", i, _B[i]);
-        }
-        applyWeights();
-        return 0;
-    }
-
-    int setOutputWeights(const float Wv[]) {
-        for (size_t i = 0; i < M; i++) {
-            _Wv[i] = Wv[i];
+    int setSparseColumns(bool enable) {
+        if (enable && M > LeastSquaresSolver::MAX_PATTERN_ROWS) {
+            return -1;
         }
-        applyWeights();
+        _sparse = enable;
         return 0;
     }
 
@@ -66,18 +93,29 @@ public:
         return 0;
     }
 
-    int calculateActuatorCommands(const float v[], float u_k[], size_t max_iterations) {
+    int calculateActuatorCommands(const AllocatorConfiguration<M, N> &configuration, const float v[], float u_k[],
+                                  size_t max_iterations) {
 
         checkActuatorLimits();
-        printf("\n");
+
+        // start every calculation with all actuators free
+        for (size_t j = 0; j < N; j++) {
+            _W[j] = 0;
+        }
+
         // multiply virtual control with weights to get b
+        const float *Wv = configuration.getOutputWeights();
         for (size_t i = 0; i < M; i++) {
-            _b[i] = v[i] * _Wv[i];
+            _b[i] = v[i] * Wv[i];
         }
 
+        _iterations = 0;
+        _converged = false;
         for (size_t i = 0; i < max_iterations; i++) {
-            if (runIteration(u_k) == 0) {
+            _iterations++;
+            if (runIteration(configuration, u_k) == 0) {
                 // optimal solution found
+                _converged = true;
                 break;
             }
         }
@@ -85,9 +123,25 @@ public:
         return 0;
     }
 
+    /**
+     * @brief Number of iterations of the last calculation
+     */
+    size_t getIterationCount() const {
+        return _iterations;
+    }
+
+    /**
+     * @brief Whether the last calculation ended before max_iterations
+     *
+     * If not, u_k is feasible but the working set was still changing.
+     */
+    bool hasConverged() const {
+        return _converged;
+    }
+
 private:
 
-    int runIteration(float u_k[]) {
+    int runIteration(const AllocatorConfiguration<M, N> &configuration, float u_k[]) {
 
         // make sure the initial solution is within bounds
         for (size_t j = 0; j < N; j++) {
@@ -99,16 +153,13 @@ private:
             }
         }
 
-        float p[M] = {0};
+        const float *A = configuration.getWeightedEffectiveness();
+        const uint32_t *pattern = configuration.getSparsityPattern();
 
-        // Construct Af
         size_t k = 0;
         for (size_t j = 0; j < N; j++) {
+            _p[j] = 0.0f;
             if (_W[j] == 0) {
-                // this actuator is not free, add to Af
-                for (size_t i = 0; i < M; i++) {
-                    _A_f[k*M + i] = _A[j*M + i];
-                }
                 k++;
             }
         }
@@ -118,41 +169,59 @@ private:
         // If there is more than one free actuator
         if (k > 0) {
             // construct d = b - A*u_k
-            float d[M] = {0};
             // d = b
             for (size_t i = 0; i < M; i++) {
-                d[i] = _b[i];
+                _d[i] = _b[i];
             }
             // d -= A*u_k
-            for (size_t l = 0; l < M*N; l++) {
-                d[l%M] -= _A[l] * u_k[l/M];
+            for (size_t j = 0; j < N; j++) {
+                if (_sparse) {
+                    for (uint32_t rows = pattern[j]; rows != 0; rows &= rows - 1u) {
+                        size_t i = LeastSquaresSolver::lowestRow(rows);
+                        _d[i] -= A[j*M + i] * u_k[j];
+                    }
+                } else {
+                    for (size_t i = 0; i < M; i++) {
+                        _d[i] -= A[j*M + i] * u_k[j];
+                    }
+                }
             }
 
             for (size_t i = 0; i < M; i++) {
-                //printf("d[%lu] = %1.15f\n", i, d[i]);
+                //printf("d[%lu] = %1.15f\n", i, _d[i]);
             }
 
-            // perturbation of free actuators from least squares solver
-            float pp[N] = {0}; // first k are filled, max N
-
-            // working space for solver
-            float tau[M] = {0};
-            float w[M] = {0};
+            // with all actuators free, the decomposition is precomputed
+            if (k < N || configuration.loadDecomposition(_solver, _w, _sparse) < 0) {
+                // Construct Af
+                size_t z = 0;
+                for (size_t j = 0; j < N; j++) {
+                    if (_W[j] == 0) {
+                        // this actuator is not free, add to Af
+                        for (size_t i = 0; i < M; i++) {
+                            _A_f[z*M + i] = A[j*M + i];
+                        }
+                        _A_f_pattern[z] = pattern[j];
+                        z++;
+                    }
+                }
+                _solver.setMatrixPivoted(_A_f, _tau, _w, _perm, M, k, _sparse ? _A_f_pattern : nullptr);
+            }
 
-            _solver.setMatrix(_A_f, tau, w, M, N);
-            _solver.solve(d, pp);
+            // perturbation of free actuators from least squares solver, in place
+            _solver.solve(_d, _d);
 
             // Construct full perturbation, including constrained ones
             size_t z = 0;
             for (size_t j = 0; j < N; j++) {
                 if (_W[j] == 0) {
-                    p[j] = pp[z];
+                    _p[j] = _d[z];
                     z++;
                 }
-                //printf("p[%lu] = %1.5f\n", j, p[j]);
+                //printf("p[%lu] = %1.5f\n", j, _p[j]);
             }
         } else {
-            printf("no free actuators\n");
+            //printf("no free actuators\n");
         }
 
         float smallest_alpha = 1.0f;
@@ -163,15 +232,15 @@ private:
             //printf("u_k[%lu] = %1.5f\n", j, u_k[j]);
             if (_W[j] == 0) {
                 float alpha = 1.0f;
-                if (u_k[j] + p[j] > _u_up[j]) {
-                    alpha = (_u_up[j] - u_k[j]) / p[j];
+                if (u_k[j] + _p[j] > _u_up[j]) {
+                    alpha = (_u_up[j] - u_k[j]) / _p[j];
                     //printf("exceed upper bound %lu\n", j);
-                    //printf("div by %1.15f\talpha: %1.30f\n", p[j], (_u_up[j] - u_k[j]));
+                    //printf("div by %1.15f\talpha: %1.30f\n", _p[j], (_u_up[j] - u_k[j]));
                 }
-                else if (u_k[j] + p[j] < _u_lo[j]) {
-                    alpha = (_u_lo[j] - u_k[j]) / p[j];
+                else if (u_k[j] + _p[j] < _u_lo[j]) {
+                    alpha = (_u_lo[j] - u_k[j]) / _p[j];
                     //printf("exceed lower bound %lu\n", j);
-                    //printf("div by %1.15f\n", p[j]);
+                    //printf("div by %1.15f\n", _p[j]);
                 }
 
                 if (alpha < smallest_alpha) {
@@ -185,16 +254,16 @@ private:
             //printf("smallest alpha at %lu = %1.5f\n", smallest_alpha_idx, smallest_alpha);
             // scale the solution to fit within bounds
             for (size_t j = 0; j < N; j++) {
-                u_k[j] += p[j] * smallest_alpha;
+                u_k[j] += _p[j] * smallest_alpha;
             }
             // add constraint to working set
-            _W[smallest_alpha_idx] = p[smallest_alpha_idx] > 0.0f ? 1 : -1;
-            printf("add %lu to working set\n", smallest_alpha_idx);
+            _W[smallest_alpha_idx] = _p[smallest_alpha_idx] > 0.0f ? 1 : -1;
+            //printf("add %lu to working set\n", smallest_alpha_idx);
         } else {
             // check if an optimal solution was found using lagrangian
             // u_k = u_k + p
             for (size_t j = 0; j < N; j++) {
-                u_k[j] += p[j];
+                u_k[j] += _p[j];
             }
             // todo: lagrangian optimality check
             return 0;
@@ -212,35 +281,129 @@ private:
         }
     }
 
-    void applyWeights()
-    {
-        for (size_t l = 0; l < M*N; l++) {
-            _A[l] = _B[l] * _Wv[l%M];
-        }
+    float _u_up[N];
+    float _u_lo[N];
+
+    float _A_f[M*N];
+    uint32_t _A_f_pattern[N];
+    float _b[M];
+    int8_t _W[N] = {0};
+
+    /**
+     * @brief Perturbation of all actuators in the current iteration
+     */
+    float _p[N];
+
+    /**
+     * @brief Residual b - A*u_k, overwritten by the perturbation of the free actuators
+     */
+    float _d[M > N ? M : N];
+
+    // working space for solver
+    float _tau[2 * (M < N ? M : N)];
+    float _w[M > N ? M : N];
+    size_t _perm[N];
+
+    LeastSquaresSolver _solver;
+    bool _sparse = false;
+
+    size_t _iterations = 0;
+    bool _converged = false;
+};
+
+/**
+ * @brief The ActiveSetAlgorithm class
+ *
+ * The algorithm gets initialized with a certain effectiveness matrix A.
+ * A weighting matrix can be supplied to favor certain outputs over others.
+ * Inputs for a calculation are the desired outputs, and the upper and lower
+ * bounds available from the actuator.
+ * The output is a vector containing the control commands.
+ *
+ * This owns its configuration. To share one configuration between several
+ * allocators, use AllocatorConfiguration and ActiveSetWorkspace directly.
+ */
+template<size_t M, size_t N>
+class ActiveSetAlgorithm
+{
+public:
+    ActiveSetAlgorithm() = default;
+
+    int setActuatorEffectiveness(const float B_row_major[]) {
+        return _configuration.setActuatorEffectiveness(B_row_major);
     }
 
     /**
-     * @brief Control effectiveness matrix
+     * @brief Rank-one update of the effectiveness matrix, B += x * y^T
      *
-     * Column major for more efficient processing
+     * @see AllocatorConfiguration::updateActuatorEffectiveness()
+     */
+    int updateActuatorEffectiveness(const float x[], const float y[], bool fill = false) {
+        return _configuration.updateActuatorEffectiveness(x, y, fill);
+    }
+
+    /**
+     * @brief Effectiveness matrix, column major
+     */
+    const float *getActuatorEffectiveness() const {
+        return _configuration.getActuatorEffectiveness();
+    }
+
+    /**
+     * @brief Use precomputed data without copying
      *
+     * @see AllocatorConfiguration::attachActuatorEffectiveness()
      */
-    float _B[M*N];
+    int attachActuatorEffectiveness(const float B[], const float Wv[], const float A[], const uint32_t pattern[]) {
+        return _configuration.attachActuatorEffectiveness(B, Wv, A, pattern);
+    }
 
     /**
-     * @brief Weights given to each degree of freedom.
+     * @brief Use precomputed data and its decomposition without copying
+     *
+     * @see AllocatorConfiguration::attachActuatorEffectiveness()
      */
-    float _Wv[M];
+    int attachActuatorEffectiveness(const float B[], const float Wv[], const float A[], const uint32_t pattern[],
+                                    const float QR[], const float tau[], const size_t perm[], size_t rank,
+                                    const uint32_t QR_pattern[]) {
+        return _configuration.attachActuatorEffectiveness(B, Wv, A, pattern, QR, tau, perm, rank, QR_pattern);
+    }
 
-    float _A[M*N]; // this is just B with applied weights
-    float _u_up[N];
-    float _u_lo[N];
+    bool isAttached() const {
+        return _configuration.isAttached();
+    }
 
-    float _A_f[M*N];
-    float _b[M];
-    int8_t _W[M] = {0};
+    int setOutputWeights(const float Wv[]) {
+        return _configuration.setOutputWeights(Wv);
+    }
 
-    LeastSquaresSolver _solver;
+    int setSparseColumns(bool enable) {
+        return _workspace.setSparseColumns(enable);
+    }
+
+    int setActuatorUpperLimit(const float u_up[]) {
+        return _workspace.setActuatorUpperLimit(u_up);
+    }
+
+    int setActuatorLowerLimit(const float u_lo[]) {
+        return _workspace.setActuatorLowerLimit(u_lo);
+    }
+
+    int calculateActuatorCommands(const float v[], float u_k[], size_t max_iterations) {
+        return _workspace.calculateActuatorCommands(_configuration, v, u_k, max_iterations);
+    }
+
+    size_t getIterationCount() const {
+        return _workspace.getIterationCount();
+    }
+
+    bool hasConverged() const {
+        return _workspace.hasConverged();
+    }
+
+private:
+    AllocatorConfiguration<M, N> _configuration;
+    ActiveSetWorkspace<M, N> _workspace;
 };
 
 } // namespace ifl_control
@@ -0,0 +1,519 @@
+/**
+ * @file AirframeDatabase.hpp
+ *
+ * Binary database of airframes with precomputed allocation data.
+ *
+ * The database is meant to be memory mapped, the allocator then attaches to
+ * the data in place. Selecting an airframe, or switching to one of its failure
+ * modes, involves no parsing and no computation: the column-pivoted QR
+ * decomposition that the allocator starts from is stored as well.
+ *
+ * Layout, native byte order and word size, all sections aligned to ALIGNMENT
+ * bytes, with K = min(M, N):
+ *
+ *   AirframeDatabaseHeader
+ *   AirframeEntry[airframe_count]
+ *   per airframe:
+ *     Wv[M]
+ *     per configuration (nominal first, then the failure modes):
+ *       failed actuator mask, rank of the decomposition
+ *       u_lo[N], u_up[N] actuator limits
+ *       B[M*N]           effectiveness, column major
+ *       A[M*N]           weighted effectiveness, column major
+ *       pattern[N]       row bitmask per column of B
+ *       QR[M*N]          decomposition of A, column major
+ *       tau[2*K]         scaling of the reflections
+ *       perm[N]          column permutation of the decomposition, size_t
+ *       QR_pattern[N]    row bitmask per column of the decomposition
+ *
+ * In a failure mode, the columns of the failed actuators are zero in B and A.
+ * The decomposition moves them behind its rank, so the allocator does not
+ * use them. Their limits are pinned to zero, or to the nearest limit if zero
+ * is out of range, so the commands of a failed actuator stay put.
+ */
+
+#pragma once
+
+#include "ActiveSetAlgorithm.hpp"
+
+namespace ifl_control {
+
+struct AirframeDatabaseHeader {
+    uint32_t magic;
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t airframe_count;
+    uint64_t size;
+    uint32_t word_size;
+    uint32_t reserved;
+};
+
+struct AirframeEntry {
+    uint32_t id;
+    uint32_t m;
+    uint32_t n;
+    uint32_t configuration_count;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+ * @brief Offsets of the sections of an airframe, relative to its start
+ */
+struct AirframeLayout {
+    static const size_t ALIGNMENT = 64;
+    static const size_t MAX_ACTUATORS = 32; // size of the failed actuator mask
+
+    AirframeLayout(size_t m, size_t n, size_t configuration_count)
+    {
+        Wv = 0;
+        configuration = Wv + align(m * sizeof(float));
+
+        failed = 0;
+        rank = failed + sizeof(uint32_t);
+        u_lo = failed + align(2 * sizeof(uint32_t));
+        u_up = u_lo + align(n * sizeof(float));
+        B = u_up + align(n * sizeof(float));
+        A = B + align(m * n * sizeof(float));
+        pattern = A + align(m * n * sizeof(float));
+        QR = pattern + align(n * sizeof(uint32_t));
+        tau = QR + align(m * n * sizeof(float));
+        perm = tau + align(2 * (m < n ? m : n) * sizeof(float));
+        QR_pattern = perm + align(n * sizeof(size_t));
+        configuration_size = QR_pattern + align(n * sizeof(uint32_t));
+
+        size = configuration + configuration_count * configuration_size;
+    }
+
+    static size_t align(size_t bytes)
+    {
+        return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    size_t Wv;
+    size_t configuration;
+    size_t configuration_size;
+
+    // within a configuration
+    size_t failed;
+    size_t rank;
+    size_t u_lo;
+    size_t u_up;
+    size_t B;
+    size_t A;
+    size_t pattern;
+    size_t QR;
+    size_t tau;
+    size_t perm;
+    size_t QR_pattern;
+
+    size_t size;
+};
+
+/**
+ * @brief View on one airframe of an attached database
+ */
+template<size_t M, size_t N>
+class AirframeRecord
+{
+public:
+    AirframeRecord() = default;
+
+    AirframeRecord(const uint8_t *data, size_t configuration_count) :
+        _data(data),
+        _configuration_count(configuration_count),
+        _layout(M, N, configuration_count)
+    {
+
+    }
+
+    size_t getConfigurationCount() const {
+        return _configuration_count;
+    }
+
+    const float *getOutputWeights() const {
+        return floats(_layout.Wv);
+    }
+
+    /**
+     * @brief Actuator limits of a configuration, failed actuators are pinned
+     */
+    const float *getActuatorLowerLimit(size_t configuration) const {
+        return floats(offset(configuration, _layout.u_lo));
+    }
+
+    const float *getActuatorUpperLimit(size_t configuration) const {
+        return floats(offset(configuration, _layout.u_up));
+    }
+
+    /**
+     * @brief Bitmask of the failed actuators of a configuration, 0 is nominal
+     */
+    uint32_t getFailedActuators(size_t configuration) const {
+        return *reinterpret_cast<const uint32_t *>(_data + offset(configuration, _layout.failed));
+    }
+
+    const float *getActuatorEffectiveness(size_t configuration) const {
+        return floats(offset(configuration, _layout.B));
+    }
+
+    const float *getWeightedEffectiveness(size_t configuration) const {
+        return floats(offset(configuration, _layout.A));
+    }
+
+    const uint32_t *getSparsityPattern(size_t configuration) const {
+        return reinterpret_cast<const uint32_t *>(_data + offset(configuration, _layout.pattern));
+    }
+
+    /**
+     * @brief Column-pivoted QR decomposition of A, column major
+     */
+    const float *getDecomposition(size_t configuration) const {
+        return floats(offset(configuration, _layout.QR));
+    }
+
+    const float *getDecompositionTau(size_t configuration) const {
+        return floats(offset(configuration, _layout.tau));
+    }
+
+    const size_t *getDecompositionPermutation(size_t configuration) const {
+        return reinterpret_cast<const size_t *>(_data + offset(configuration, _layout.perm));
+    }
+
+    size_t getDecompositionRank(size_t configuration) const {
+        return *reinterpret_cast<const uint32_t *>(_data + offset(configuration, _layout.rank));
+    }
+
+    const uint32_t *getDecompositionPattern(size_t configuration) const {
+        return reinterpret_cast<const uint32_t *>(_data + offset(configuration, _layout.QR_pattern));
+    }
+
+    /**
+     * @brief Attach the allocator to a configuration and apply its limits
+     */
+    int attach(ActiveSetAlgorithm<M, N> &allocator, size_t configuration) const {
+        if (_data == nullptr || configuration >= _configuration_count) {
+            return -1;
+        }
+        if (allocator.attachActuatorEffectiveness(getActuatorEffectiveness(configuration), getOutputWeights(),
+                                                  getWeightedEffectiveness(configuration),
+                                                  getSparsityPattern(configuration),
+                                                  getDecomposition(configuration),
+                                                  getDecompositionTau(configuration),
+                                                  getDecompositionPermutation(configuration),
+                                                  getDecompositionRank(configuration),
+                                                  getDecompositionPattern(configuration)) < 0) {
+            return -1;
+        }
+        allocator.setActuatorLowerLimit(getActuatorLowerLimit(configuration));
+        allocator.setActuatorUpperLimit(getActuatorUpperLimit(configuration));
+        return 0;
+    }
+
+    /**
+     * @brief Attach a shared configuration
+     *
+     * The limits are set per workspace, from getActuatorLowerLimit() and
+     * getActuatorUpperLimit() of the same configuration.
+     */
+    int attach(AllocatorConfiguration<M, N> &shared, size_t configuration) const {
+        if (_data == nullptr || configuration >= _configuration_count) {
+            return -1;
+        }
+        return shared.attachActuatorEffectiveness(getActuatorEffectiveness(configuration), getOutputWeights(),
+                                                  getWeightedEffectiveness(configuration),
+                                                  getSparsityPattern(configuration),
+                                                  getDecomposition(configuration),
+                                                  getDecompositionTau(configuration),
+                                                  getDecompositionPermutation(configuration),
+                                                  getDecompositionRank(configuration),
+                                                  getDecompositionPattern(configuration));
+    }
+
+private:
+    size_t offset(size_t configuration, size_t section) const {
+        return _layout.configuration + configuration * _layout.configuration_size + section;
+    }
+
+    const float *floats(size_t offset) const {
+        return reinterpret_cast<const float *>(_data + offset);
+    }
+
+    const uint8_t *_data = nullptr;
+    size_t _configuration_count = 0;
+    AirframeLayout _layout{M, N, 0};
+};
+
+/**
+ * @brief Read access to a database in memory, typically a MappedFile
+ */
+class AirframeDatabase
+{
+public:
+    static const uint32_t MAGIC = 0x41444649; // "IFDA"
+    static const uint32_t ENDIANNESS = 0x01020304;
+    static const uint32_t VERSION = 3;
+
+    AirframeDatabase() = default;
+
+    /**
+     * @brief Validate the database and use it in place
+     *
+     * The memory must stay valid while the database, or any record or
+     * allocator attached to it, is in use.
+     *
+     * Besides the sizes, the rank and the column permutation of every
+     * decomposition are checked, so a damaged file cannot make the solver
+     * index out of bounds.
+     */
+    int attach(const void *data, size_t size)
+    {
+        _data = nullptr;
+        _header = nullptr;
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        if (bytes == nullptr || reinterpret_cast<uintptr_t>(bytes) % AirframeLayout::ALIGNMENT != 0) {
+            return -1;
+        }
+        if (size < sizeof(AirframeDatabaseHeader)) {
+            return -1;
+        }
+
+        const AirframeDatabaseHeader *header = reinterpret_cast<const AirframeDatabaseHeader *>(bytes);
+        if (header->magic != MAGIC || header->byte_order != ENDIANNESS || header->version != VERSION ||
+            header->word_size != sizeof(size_t)) {
+            return -1;
+        }
+        if (header->size > size || header->size < tableOffset() + header->airframe_count * sizeof(AirframeEntry)) {
+            return -1;
+        }
+
+        const AirframeEntry *entries = reinterpret_cast<const AirframeEntry *>(bytes + tableOffset());
+        for (size_t k = 0; k < header->airframe_count; k++) {
+            const AirframeEntry &entry = entries[k];
+            AirframeLayout layout(entry.m, entry.n, entry.configuration_count);
+            if (entry.offset % AirframeLayout::ALIGNMENT != 0 || entry.size != layout.size ||
+                entry.offset > header->size || entry.size > header->size - entry.offset ||
+                entry.n > AirframeLayout::MAX_ACTUATORS) {
+                return -1;
+            }
+            for (size_t c = 0; c < entry.configuration_count; c++) {
+                if (!isValidDecomposition(bytes + entry.offset + layout.configuration + c * layout.configuration_size,
+                                          layout, entry.m, entry.n)) {
+                    return -1;
+                }
+            }
+        }
+
+        _data = bytes;
+        _header = header;
+        _entries = entries;
+        return 0;
+    }
+
+    size_t getAirframeCount() const {
+        return _header != nullptr ? _header->airframe_count : 0;
+    }
+
+    /**
+     * @brief Find an airframe by id, its dimensions must match
+     */
+    template<size_t M, size_t N>
+    int find(uint32_t id, AirframeRecord<M, N> &record) const {
+        for (size_t k = 0; k < getAirframeCount(); k++) {
+            const AirframeEntry &entry = _entries[k];
+            if (entry.id == id) {
+                if (entry.m != M || entry.n != N) {
+                    return -1;
+                }
+                record = AirframeRecord<M, N>(_data + entry.offset, entry.configuration_count);
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    static size_t tableOffset() {
+        return AirframeLayout::align(sizeof(AirframeDatabaseHeader));
+    }
+
+    static size_t dataOffset(size_t airframe_count) {
+        return tableOffset() + AirframeLayout::align(airframe_count * sizeof(AirframeEntry));
+    }
+
+private:
+    /**
+     * @brief Check the rank and that the permutation contains every column exactly once
+     */
+    static bool isValidDecomposition(const uint8_t *configuration, const AirframeLayout &layout, size_t m, size_t n)
+    {
+        const uint32_t rank = *reinterpret_cast<const uint32_t *>(configuration + layout.rank);
+        if (rank > (m < n ? m : n)) {
+            return false;
+        }
+        const size_t *perm = reinterpret_cast<const size_t *>(configuration + layout.perm);
+        uint32_t used = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (perm[j] >= n || ((used >> perm[j]) & 1u)) {
+                return false;
+            }
+            used |= 1u << perm[j];
+        }
+        return true;
+    }
+
+    const uint8_t *_data = nullptr;
+    const AirframeDatabaseHeader *_header = nullptr;
+    const AirframeEntry *_entries = nullptr;
+};
+
+/**
+ * @brief Builds a database in a buffer, with all allocation data precomputed
+ *
+ * This is meant to run offline. The buffer must be aligned to
+ * AirframeLayout::ALIGNMENT and zero initialized.
+ */
+class AirframeDatabaseWriter
+{
+public:
+    /**
+     * @param data Buffer for the database
+     * @param size Size of the buffer
+     * @param max_airframes Number of airframes the table has room for
+     */
+    AirframeDatabaseWriter(void *data, size_t size, size_t max_airframes) :
+        _data(static_cast<uint8_t *>(data)),
+        _size(size),
+        _max_airframes(max_airframes),
+        _end(AirframeDatabase::dataOffset(max_airframes))
+    {
+
+    }
+
+    /**
+     * @brief Add an airframe, with a configuration per failure mode
+     *
+     * @param id Identifier of the airframe
+     * @param B_row_major Effectiveness matrix, row major as in ActiveSetAlgorithm
+     * @param Wv Output weights (M)
+     * @param u_lo Lower actuator limits (N)
+     * @param u_up Upper actuator limits (N)
+     * @param failure_modes Bitmask of failed actuators per failure mode
+     * @param failure_mode_count Number of failure modes
+     */
+    template<size_t M, size_t N>
+    int addAirframe(uint32_t id, const float B_row_major[], const float Wv[], const float u_lo[], const float u_up[],
+                    const uint32_t failure_modes[], size_t failure_mode_count)
+    {
+        const size_t count = 1 + failure_mode_count;
+        AirframeLayout layout(M, N, count);
+        if (_count >= _max_airframes || _end + layout.size > _size || N > AirframeLayout::MAX_ACTUATORS) {
+            return -1;
+        }
+
+        uint8_t *airframe = _data + _end;
+        float *Wv_out = reinterpret_cast<float *>(airframe + layout.Wv);
+        for (size_t i = 0; i < M; i++) {
+            Wv_out[i] = Wv[i];
+        }
+
+        for (size_t c = 0; c < count; c++) {
+            uint8_t *configuration = airframe + layout.configuration + c * layout.configuration_size;
+            const uint32_t failed = c == 0 ? 0 : failure_modes[c - 1];
+            *reinterpret_cast<uint32_t *>(configuration + layout.failed) = failed;
+
+            float *u_lo_out = reinterpret_cast<float *>(configuration + layout.u_lo);
+            float *u_up_out = reinterpret_cast<float *>(configuration + layout.u_up);
+            for (size_t j = 0; j < N; j++) {
+                u_lo_out[j] = u_lo[j];
+                u_up_out[j] = u_up[j];
+                if ((failed >> j) & 1u) {
+                    // pin the failed actuator at zero, within its range
+                    const float pinned = u_lo[j] > 0.0f ? u_lo[j] : (u_up[j] < 0.0f ? u_up[j] : 0.0f);
+                    u_lo_out[j] = pinned;
+                    u_up_out[j] = pinned;
+                }
+            }
+
+            float *B = reinterpret_cast<float *>(configuration + layout.B);
+            float *A = reinterpret_cast<float *>(configuration + layout.A);
+            uint32_t *pattern = reinterpret_cast<uint32_t *>(configuration + layout.pattern);
+            float *QR = reinterpret_cast<float *>(configuration + layout.QR);
+            float *tau = reinterpret_cast<float *>(configuration + layout.tau);
+            size_t *perm = reinterpret_cast<size_t *>(configuration + layout.perm);
+            uint32_t *QR_pattern = reinterpret_cast<uint32_t *>(configuration + layout.QR_pattern);
+
+            for (size_t j = 0; j < N; j++) {
+                pattern[j] = 0;
+                for (size_t i = 0; i < M; i++) {
+                    const size_t l = j*M + i;
+                    B[l] = (failed >> j) & 1u ? 0.0f : B_row_major[i*N + j];
+                    A[l] = B[l] * Wv[i];
+                    if (M <= LeastSquaresSolver::MAX_PATTERN_ROWS && abs(B[l]) > 0.0f) {
+                        pattern[j] |= 1u << i;
+                    }
+                }
+            }
+
+            // same decomposition as AllocatorConfiguration computes
+            for (size_t l = 0; l < M*N; l++) {
+                QR[l] = A[l];
+            }
+            for (size_t j = 0; j < N; j++) {
+                QR_pattern[j] = pattern[j];
+            }
+            LeastSquaresSolver solver;
+            float w[M > N ? M : N];
+            if (solver.setMatrixPivoted(QR, tau, w, perm, M, N,
+                                        M <= LeastSquaresSolver::MAX_PATTERN_ROWS ? QR_pattern : nullptr) < 0) {
+                return -1;
+            }
+            *reinterpret_cast<uint32_t *>(configuration + layout.rank) = static_cast<uint32_t>(solver.getRank());
+        }
+
+        AirframeEntry &entry = reinterpret_cast<AirframeEntry *>(_data + AirframeDatabase::tableOffset())[_count];
+        entry.id = id;
+        entry.m = static_cast<uint32_t>(M);
+        entry.n = static_cast<uint32_t>(N);
+        entry.configuration_count = static_cast<uint32_t>(count);
+        entry.offset = _end;
+        entry.size = layout.size;
+
+        _count++;
+        _end += layout.size;
+        return 0;
+    }
+
+    /**
+     * @brief Write the header, returns the size of the database
+     */
+    size_t finalize()
+    {
+        AirframeDatabaseHeader *header = reinterpret_cast<AirframeDatabaseHeader *>(_data);
+        header->magic = AirframeDatabase::MAGIC;
+        header->byte_order = AirframeDatabase::ENDIANNESS;
+        header->version = AirframeDatabase::VERSION;
+        header->airframe_count = static_cast<uint32_t>(_count);
+        header->size = _end;
+        header->word_size = static_cast<uint32_t>(sizeof(size_t));
+        header->reserved = 0;
+        return _end;
+    }
+
+    /**
+     * @brief Size of a database for the given airframes
+     */
+    static size_t requiredSize(size_t max_airframes, size_t airframe_bytes)
+    {
+        return AirframeDatabase::dataOffset(max_airframes) + airframe_bytes;
+    }
+
+private:
+    uint8_t *_data;
+    size_t _size;
+    size_t _max_airframes;
+    size_t _count = 0;
+    size_t _end;
+};
+
+} // namespace ifl_control
@@ -0,0 +1,380 @@
+/**
+ * @file AllocatorConfiguration.hpp
+ *
+ * Immutable part of the allocation problem: the effectiveness matrix, the
+ * output weights and everything that is derived from them.
+ *
+ * The configuration is only read during an allocation, so any number of
+ * ActiveSetWorkspace instances can share one, for example all vehicles of the
+ * same airframe in a simulation. It must not be modified while one of them is
+ * allocating.
+ *
+ * Memory use, in bytes before padding, with K = min(M, N):
+ *
+ *   12*M*N + 4*M + 8*K + 16*N + 1 + 9 words
+ *
+ * That is B, A and the decomposition of A (M*N floats each), Wv (M floats),
+ * tau (2*K floats), the sparsity pattern of B and of the decomposition
+ * (N 32 bit words each), the column permutation of the decomposition
+ * (N words), its rank, a flag and the pointers to attached data (8 words).
+ * Sizes are for a 64 bit target.
+ */
+
+#pragma once
+
+#include "LeastSquaresSolver.hpp"
+
+namespace ifl_control {
+
+/**
+ * @brief The AllocatorConfiguration class
+ *
+ * Besides the weighted effectiveness A, the column-pivoted QR decomposition of
+ * A with all actuators free is precomputed. This is the first subproblem of
+ * every allocation, so the first iteration does not have to decompose.
+ *
+ * Instead of copying the effectiveness, the configuration can attach to
+ * precomputed data that is kept elsewhere, for example in a memory mapped
+ * AirframeDatabase, optionally including the decomposition. Modifying the
+ * effectiveness or weights detaches it again.
+ */
+template<size_t M, size_t N>
+class AllocatorConfiguration
+{
+public:
+    AllocatorConfiguration() :
+        _B{},
+        _Wv{},
+        _A{},
+        _QR{},
+        _tau{}
+    {
+
+    }
+
+    int setActuatorEffectiveness(const float B_row_major[]) {
+        detach();
+        // Is provided row-major. Convert to column major
+        for (size_t i = 0; i < M*N; i++) {
+            _B[i] = B_row_major[(i%M)*N + (i/M)];
+        }
+        updateSparsityPattern();
+        applyWeights();
+        decompose();
+        return 0;
+    }
+
+    /**
+     * @brief Rank-one update of the effectiveness matrix, B += x * y^T
+     *
+     * Lets an online estimator publish its update in place, without
+     * uploading and transposing the full row-major matrix. The weighted
+     * matrix is updated along. The precomputed decomposition is dropped
+     * instead of recomputed, as an estimator updates at every tick, and the
+     * workspaces decompose the free columns themselves.
+     *
+     * The update is masked with the sparsity pattern, so structural zeros,
+     * like the yaw moment of a propeller without tilt, stay zero. With
+     * fill, entries outside of the pattern are updated too and added to it.
+     * Without a pattern, for M above LeastSquaresSolver::MAX_PATTERN_ROWS,
+     * every entry is updated.
+     *
+     * @param x Column vector (M)
+     * @param y Row vector (N)
+     * @param fill Also update the structural zeros
+     */
+    int updateActuatorEffectiveness(const float x[], const float y[], bool fill = false) {
+        detach();
+        for (size_t j = 0; j < N; j++) {
+            for (size_t i = 0; i < M; i++) {
+                size_t l = j*M + i;
+                if (usePattern() && ((_B_pattern[j] >> i) & 1u) == 0) {
+                    if (!fill) {
+                        continue;
+                    }
+                    _B[l] = x[i] * y[j];
+                    if (abs(_B[l]) > 0.0f) {
+                        _B_pattern[j] |= 1u << i;
+                    }
+                } else {
+                    _B[l] += x[i] * y[j];
+                }
+                _A[l] = _B[l] * _Wv[i];
+            }
+        }
+        _decomposed = false;
+        return 0;
+    }
+
+    /**
+     * @brief Use precomputed data without copying
+     *
+     * The data must stay valid and unchanged while attached.
+     *
+     * @param B Effectiveness matrix, column major (M*N)
+     * @param Wv Output weights (M)
+     * @param A Weighted effectiveness matrix, column major (M*N)
+     * @param pattern Row bitmask per column of B (N)
+     */
+    int attachActuatorEffectiveness(const float B[], const float Wv[], const float A[], const uint32_t pattern[]) {
+        if (attach(B, Wv, A, pattern) < 0) {
+            return -1;
+        }
+        decompose();
+        return 0;
+    }
+
+    /**
+     * @brief Use precomputed data and its decomposition without copying
+     *
+     * The decomposition is the column-pivoted QR decomposition of A, as from
+     * LeastSquaresSolver::setMatrixPivoted() with all N columns, so nothing
+     * is computed when attaching. The permutation and the rank are checked,
+     * as the solver indexes with them.
+     *
+     * @param QR Decomposition of A (M*N)
+     * @param tau Scaling of the reflections (2 * min(M, N))
+     * @param perm Column permutation (N)
+     * @param rank Rank of the decomposition
+     * @param QR_pattern Pattern of the decomposition, with fill-in (N), may be null if M does not fit in a pattern
+     */
+    int attachActuatorEffectiveness(const float B[], const float Wv[], const float A[], const uint32_t pattern[],
+                                    const float QR[], const float tau[], const size_t perm[], size_t rank,
+                                    const uint32_t QR_pattern[]) {
+        if (QR == nullptr || tau == nullptr || perm == nullptr || rank > (M < N ? M : N) ||
+            (usePattern() && QR_pattern == nullptr) || !isPermutation(perm)) {
+            return -1;
+        }
+        if (attach(B, Wv, A, pattern) < 0) {
+            return -1;
+        }
+        _attached_QR = QR;
+        _attached_tau = tau;
+        _attached_perm = perm;
+        _attached_QR_pattern = QR_pattern;
+        _rank = rank;
+        _decomposed = true;
+        return 0;
+    }
+
+    bool isAttached() const {
+        return _attached_B != nullptr;
+    }
+
+    int setOutputWeights(const float Wv[]) {
+        detach();
+        for (size_t i = 0; i < M; i++) {
+            _Wv[i] = Wv[i];
+        }
+        applyWeights();
+        decompose();
+        return 0;
+    }
+
+    /**
+     * @brief Effectiveness matrix, column major
+     */
+    const float *getActuatorEffectiveness() const {
+        return _attached_B != nullptr ? _attached_B : _B;
+    }
+
+    const float *getOutputWeights() const {
+        return _attached_B != nullptr ? _attached_Wv : _Wv;
+    }
+
+    /**
+     * @brief Effectiveness matrix with the output weights applied, column major
+     */
+    const float *getWeightedEffectiveness() const {
+        return _attached_B != nullptr ? _attached_A : _A;
+    }
+
+    /**
+     * @brief Row bitmask per column of B, bit i is set if row i is non-zero
+     *
+     * Only maintained when M is at most LeastSquaresSolver::MAX_PATTERN_ROWS.
+     */
+    const uint32_t *getSparsityPattern() const {
+        return _attached_B != nullptr ? _attached_pattern : _B_pattern;
+    }
+
+    /**
+     * @brief Load the decomposition of A with all actuators free into a solver
+     *
+     * @param solver Solver of the workspace
+     * @param w Working space of the solver (max(M, N))
+     * @param sparse Use the sparsity pattern of the decomposition
+     * @return 0 on success, -1 when there is no decomposition
+     */
+    int loadDecomposition(LeastSquaresSolver &solver, float w[], bool sparse) const {
+        if (!_decomposed || (sparse && !usePattern())) {
+            return -1;
+        }
+        if (_attached_QR != nullptr) {
+            return solver.setDecomposition(_attached_QR, _attached_tau, _attached_perm, _rank, w, M, N,
+                                           sparse ? _attached_QR_pattern : nullptr);
+        }
+        return solver.setDecomposition(_QR, _tau, _perm, _rank, w, M, N, sparse ? _QR_pattern : nullptr);
+    }
+
+private:
+    static bool usePattern()
+    {
+        return M <= LeastSquaresSolver::MAX_PATTERN_ROWS;
+    }
+
+    /**
+     * @brief Check that perm contains every column index exactly once
+     */
+    static bool isPermutation(const size_t perm[])
+    {
+        bool used[N] = {};
+        for (size_t j = 0; j < N; j++) {
+            if (perm[j] >= N || used[perm[j]]) {
+                return false;
+            }
+            used[perm[j]] = true;
+        }
+        return true;
+    }
+
+    int attach(const float B[], const float Wv[], const float A[], const uint32_t pattern[])
+    {
+        if (B == nullptr || Wv == nullptr || A == nullptr || pattern == nullptr) {
+            return -1;
+        }
+        _attached_B = B;
+        _attached_Wv = Wv;
+        _attached_A = A;
+        _attached_pattern = pattern;
+        _attached_QR = nullptr;
+        _attached_tau = nullptr;
+        _attached_perm = nullptr;
+        _attached_QR_pattern = nullptr;
+        return 0;
+    }
+
+    void applyWeights()
+    {
+        for (size_t l = 0; l < M*N; l++) {
+            if (!usePattern() || ((_B_pattern[l/M] >> (l%M)) & 1u)) {
+                _A[l] = _B[l] * _Wv[l%M];
+            }
+        }
+    }
+
+    /**
+     * @brief Recompute the zero pattern of B
+     *
+     * Zeros in B are also written to A, so A stays consistent when
+     * applyWeights() skips them.
+     */
+    void updateSparsityPattern()
+    {
+        if (!usePattern()) {
+            return;
+        }
+        for (size_t j = 0; j < N; j++) {
+            _B_pattern[j] = 0;
+        }
+        for (size_t l = 0; l < M*N; l++) {
+            if (abs(_B[l]) > 0.0f) {
+                _B_pattern[l/M] |= 1u << (l%M);
+            } else {
+                _A[l] = 0.0f;
+            }
+        }
+    }
+
+    /**
+     * @brief QR decomposition of A, the subproblem with all actuators free
+     */
+    void decompose()
+    {
+        const float *A = getWeightedEffectiveness();
+        const uint32_t *pattern = getSparsityPattern();
+        for (size_t l = 0; l < M*N; l++) {
+            _QR[l] = A[l];
+        }
+        for (size_t j = 0; j < N; j++) {
+            _QR_pattern[j] = pattern[j];
+        }
+
+        float w[M > N ? M : N];
+        LeastSquaresSolver solver;
+        _decomposed = solver.setMatrixPivoted(_QR, _tau, w, _perm, M, N, usePattern() ? _QR_pattern : nullptr) == 0;
+        _rank = solver.getRank();
+    }
+
+    /**
+     * @brief Copy attached data, so it can be modified
+     */
+    void detach()
+    {
+        if (_attached_B == nullptr) {
+            return;
+        }
+        for (size_t l = 0; l < M*N; l++) {
+            _B[l] = _attached_B[l];
+            _A[l] = _attached_A[l];
+        }
+        for (size_t i = 0; i < M; i++) {
+            _Wv[i] = _attached_Wv[i];
+        }
+        for (size_t j = 0; j < N; j++) {
+            _B_pattern[j] = _attached_pattern[j];
+        }
+        _attached_B = nullptr;
+        _attached_Wv = nullptr;
+        _attached_A = nullptr;
+        _attached_pattern = nullptr;
+        _attached_QR = nullptr;
+        _attached_tau = nullptr;
+        _attached_perm = nullptr;
+        _attached_QR_pattern = nullptr;
+    }
+
+    /**
+     * @brief Control effectiveness matrix
+     *
+     * Column major for more efficient processing
+     *
+     */
+    float _B[M*N];
+
+    /**
+     * @brief Weights given to each degree of freedom.
+     */
+    float _Wv[M];
+
+    /**
+     * @brief Row bitmask per column of B, bit i is set if row i is non-zero.
+     */
+    uint32_t _B_pattern[N] = {0};
+
+    float _A[M*N]; // this is just B with applied weights
+
+    /**
+     * @brief Decomposition of A, Householder vectors below the diagonal
+     */
+    float _QR[M*N];
+    float _tau[2 * (M < N ? M : N)];
+    uint32_t _QR_pattern[N] = {0};
+    size_t _perm[N] = {0};
+    size_t _rank = 0;
+    bool _decomposed = false;
+
+    /**
+     * @brief Precomputed data used instead of the members above, if not null
+     */
+    const float *_attached_B = nullptr;
+    const float *_attached_Wv = nullptr;
+    const float *_attached_A = nullptr;
+    const uint32_t *_attached_pattern = nullptr;
+    const float *_attached_QR = nullptr;
+    const float *_attached_tau = nullptr;
+    const size_t *_attached_perm = nullptr;
+    const uint32_t *_attached_QR_pattern = nullptr;
+};
+
+} // namespace ifl_control
@@ -0,0 +1,136 @@
+/**
+ * @file EffectivenessEstimator.hpp
+ *
+ * Online estimation of the actuator effectiveness matrix.
+ *
+ * The effectiveness drifts with battery voltage, payload and damage. With the
+ * filtered increments of the actuators (du) and of the angular acceleration
+ * (dw), every row i of the matrix is corrected with normalized least mean
+ * squares:
+ *
+ *   e = dw - B * du
+ *   B += diag(mu) * e * du^T / (eps + P)
+ *
+ * where P is the excitation power du^T * du, smoothed with the forgetting
+ * factor lambda as P = lambda * P + (1 - lambda) * du^T * du, so mu sets the
+ * same step size for every lambda. One update costs O(M*N) and is published
+ * to the allocator as a rank-one update of its column-major matrix.
+ */
+
+#pragma once
+
+#include "ActiveSetAlgorithm.hpp"
+
+namespace ifl_control {
+
+/**
+ * @brief The EffectivenessEstimator class
+ *
+ * The estimate itself is not stored here, it is the matrix of the allocator.
+ */
+template<size_t M, size_t N>
+class EffectivenessEstimator
+{
+public:
+    EffectivenessEstimator() :
+        _mu{},
+        _e{}
+    {
+
+    }
+
+    /**
+     * @brief Learning rate per output, zero disables adaptation of that row
+     */
+    int setLearningRate(const float mu[]) {
+        for (size_t i = 0; i < M; i++) {
+            if (mu[i] < 0.0f || mu[i] > 1.0f) {
+                return -1;
+            }
+        }
+        for (size_t i = 0; i < M; i++) {
+            _mu[i] = mu[i];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Forgetting factor of the excitation power, 0 is plain NLMS
+     */
+    int setForgettingFactor(float lambda) {
+        if (lambda < 0.0f || lambda >= 1.0f) {
+            return -1;
+        }
+        _lambda = lambda;
+        return 0;
+    }
+
+    /**
+     * @brief Minimum excitation du^T * du for an update to take place
+     */
+    int setMinimumExcitation(float excitation) {
+        if (excitation < 0.0f) {
+            return -1;
+        }
+        _min_excitation = excitation;
+        return 0;
+    }
+
+    /**
+     * @brief Correct the effectiveness of the allocator with one sample
+     *
+     * @param du Increment of the filtered actuator state (N)
+     * @param dw Increment of the filtered angular acceleration (M)
+     * @param allocator Allocator that holds the estimate
+     * @return 0 when the estimate was updated, 1 when the excitation was too low
+     */
+    int update(const float du[], const float dw[], ActiveSetAlgorithm<M, N> &allocator) {
+        float excitation = 0.0f;
+        for (size_t j = 0; j < N; j++) {
+            excitation += du[j] * du[j];
+        }
+        _power = _lambda * _power + (1.0f - _lambda) * excitation;
+
+        if (excitation <= _min_excitation) {
+            return 1;
+        }
+
+        // e = dw - B * du
+        const float *B = allocator.getActuatorEffectiveness();
+        for (size_t i = 0; i < M; i++) {
+            _e[i] = dw[i];
+        }
+        for (size_t l = 0; l < M*N; l++) {
+            _e[l%M] -= B[l] * du[l/M];
+        }
+
+        const float scale = 1.0f / (_epsilon + _power);
+        for (size_t i = 0; i < M; i++) {
+            _e[i] *= _mu[i] * scale;
+        }
+
+        return allocator.updateActuatorEffectiveness(_e, du);
+    }
+
+    /**
+     * @brief Reset the excitation power
+     */
+    void reset() {
+        _power = 0.0f;
+    }
+
+private:
+    float _mu[M];
+
+    /**
+     * @brief Prediction error, scaled to the row update in place
+     */
+    float _e[M];
+
+    float _lambda = 0.0f;
+    float _power = 0.0f;
+    float _epsilon = 1e-6f;
+    float _min_excitation = 0.0f;
+};
+
+} // namespace ifl_control
@@ -0,0 +1,683 @@
+/**
+ * @file HorizonAllocator.hpp
+ *
+ * Receding horizon control allocation with actuator rate limits.
+ *
+ * Instead of allocating a single sample, the commands u_0 .. u_{H-1} for the
+ * virtual controls of the next H samples are solved at once:
+ *
+ *   min sum_t |Wv * (B * u_t - v_t)|^2 + |Wr * (u_t - u_{t-1})|^2
+ *   s.t. u_lo <= u_t <= u_up
+ *        |u_t - u_{t-1}| <= r
+ *
+ * where u_{-1} is the command that was applied last. Only u_0 is meant to be
+ * applied, the problem is solved again at the next sample.
+ *
+ * The constraints are handled with the same primal active set iteration as in
+ * ActiveSetAlgorithm. An active bound fixes a command. An active rate limit
+ * ties the step of a command to the step of the same actuator one sample
+ * earlier, so the two share one unknown.
+ *
+ * The least squares problem of every iteration is block banded: the commands
+ * of sample t only appear together with those of samples t-1 and t+1. It is
+ * solved with a block QR recursion. Every block is decomposed by its own
+ * LeastSquaresSolver, which eliminates the unknowns of sample t and leaves a
+ * triangular block of information about sample t+1 for the next block. The
+ * cost of an iteration is linear in H.
+ */
+
+#pragma once
+
+#include "LeastSquaresSolver.hpp"
+
+namespace ifl_control {
+
+/**
+ * @brief The HorizonAllocator class
+ *
+ * M is the number of outputs, N the number of actuators and H the number of
+ * samples in the horizon. The rate limits are changes per sample.
+ */
+template<size_t M, size_t N, size_t H>
+class HorizonAllocator
+{
+public:
+    HorizonAllocator() :
+        _B{},
+        _Wv{},
+        _A{},
+        _u_up{},
+        _u_lo{},
+        _rate{},
+        _w_rate{}
+    {
+        for (size_t j = 0; j < N; j++) {
+            _rate[j] = 1e10f;
+            _w_rate[j] = 1.0f;
+        }
+    }
+
+    int setActuatorEffectiveness(const float B_row_major[]) {
+        // Is provided row-major. Convert to column major
+        for (size_t i = 0; i < M*N; i++) {
+            _B[i] = B_row_major[(i%M)*N + (i/M)];
+        }
+        applyWeights();
+        return 0;
+    }
+
+    int setOutputWeights(const float Wv[]) {
+        for (size_t i = 0; i < M; i++) {
+            _Wv[i] = Wv[i];
+        }
+        applyWeights();
+        return 0;
+    }
+
+    int setActuatorUpperLimit(const float u_up[]) {
+        for (size_t j = 0; j < N; j++) {
+            _u_up[j] = u_up[j];
+        }
+        return 0;
+    }
+
+    int setActuatorLowerLimit(const float u_lo[]) {
+        for (size_t j = 0; j < N; j++) {
+            _u_lo[j] = u_lo[j];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Maximum change of each actuator command per sample
+     */
+    int setActuatorRateLimit(const float rate[]) {
+        for (size_t j = 0; j < N; j++) {
+            if (rate[j] < 0.0f) {
+                return -1;
+            }
+        }
+        for (size_t j = 0; j < N; j++) {
+            _rate[j] = rate[j];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Weight on the change of each actuator command per sample
+     *
+     * The weights must be positive, they keep every block of the problem
+     * well posed, also when the actuators are redundant.
+     */
+    int setRateWeights(const float Wr[]) {
+        for (size_t j = 0; j < N; j++) {
+            if (Wr[j] <= 0.0f) {
+                return -1;
+            }
+        }
+        for (size_t j = 0; j < N; j++) {
+            _w_rate[j] = Wr[j];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Allocate the virtual controls over the horizon
+     *
+     * @param v Virtual controls, M per sample, H samples
+     * @param u_prev Last applied command (N)
+     * @param u Commands, N per sample, H samples. The first N are to be applied.
+     * @param max_iterations Maximum number of active set iterations
+     */
+    int calculateActuatorCommands(const float v[], const float u_prev[], float u[], size_t max_iterations) {
+
+        checkActuatorLimits();
+
+        for (size_t l = 0; l < H*M; l++) {
+            _b[l] = v[l] * _Wv[l%M];
+        }
+
+        // start from a feasible trajectory, the last command held within the limits
+        for (size_t j = 0; j < N; j++) {
+            _u_prev[j] = clamp(u_prev[j], _u_lo[j], _u_up[j]);
+        }
+        for (size_t t = 0; t < H; t++) {
+            for (size_t j = 0; j < N; j++) {
+                const float prev = t == 0 ? _u_prev[j] : u[(t-1)*N + j];
+                float lo = prev - _rate[j];
+                float up = prev + _rate[j];
+                lo = lo > _u_lo[j] ? lo : _u_lo[j];
+                up = up < _u_up[j] ? up : _u_up[j];
+                u[t*N + j] = clamp(u[t*N + j], lo, up);
+            }
+        }
+
+        // start every calculation with all constraints inactive
+        for (size_t l = 0; l < H*N; l++) {
+            _W_box[l] = 0;
+            _W_rate[l] = 0;
+        }
+
+        for (size_t i = 0; i < max_iterations; i++) {
+            int ret = runIteration(u);
+            if (ret < 0) {
+                return -1;
+            }
+            if (ret == 0) {
+                // optimal solution found
+                break;
+            }
+        }
+
+        return 0;
+    }
+
+private:
+
+    int runIteration(float u[]) {
+
+        updateUnknowns();
+
+        // forward: eliminate the unknowns of every sample
+        for (size_t t = 0; t < H; t++) {
+            if (eliminate(t, u) < 0) {
+                return -1;
+            }
+        }
+
+        // backward: substitute the unknowns of the later samples
+        for (size_t l = H; l > 0; l--) {
+            substitute(l - 1);
+        }
+
+        for (size_t t = 0; t < H; t++) {
+            for (size_t j = 0; j < N; j++) {
+                const size_t e = _elim[t*N + j];
+                _p[t*N + j] = e < H ? _x[e*N + j] : 0.0f;
+            }
+        }
+
+        // check feasibility of the step for all bounds and rate limits
+        float smallest_alpha = 1.0f;
+        size_t smallest_alpha_idx = 0;
+        int8_t smallest_alpha_type = 0;
+        int8_t smallest_alpha_sign = 0;
+
+        for (size_t l = 0; l < H*N; l++) {
+            const size_t j = l%N;
+
+            if (_W_box[l] == 0) {
+                float alpha = 1.0f;
+                int8_t sign = 0;
+                if (u[l] + _p[l] > _u_up[j]) {
+                    alpha = (_u_up[j] - u[l]) / _p[l];
+                    sign = 1;
+                } else if (u[l] + _p[l] < _u_lo[j]) {
+                    alpha = (_u_lo[j] - u[l]) / _p[l];
+                    sign = -1;
+                }
+                if (alpha < smallest_alpha) {
+                    smallest_alpha = alpha;
+                    smallest_alpha_idx = l;
+                    smallest_alpha_type = BOX;
+                    smallest_alpha_sign = sign;
+                }
+            }
+
+            if (_W_rate[l] == 0) {
+                const float du = u[l] - (l < N ? _u_prev[j] : u[l-N]);
+                const float dp = _p[l] - (l < N ? 0.0f : _p[l-N]);
+                float alpha = 1.0f;
+                int8_t sign = 0;
+                if (du + dp > _rate[j]) {
+                    alpha = (_rate[j] - du) / dp;
+                    sign = 1;
+                } else if (du + dp < -_rate[j]) {
+                    alpha = (-_rate[j] - du) / dp;
+                    sign = -1;
+                }
+                if (alpha < smallest_alpha) {
+                    smallest_alpha = alpha;
+                    smallest_alpha_idx = l;
+                    smallest_alpha_type = RATE;
+                    smallest_alpha_sign = sign;
+                }
+            }
+        }
+
+        if (smallest_alpha < 1.0f) {
+            if (smallest_alpha < 0.0f) {
+                smallest_alpha = 0.0f;
+            }
+            // scale the step to fit within the constraints
+            for (size_t l = 0; l < H*N; l++) {
+                u[l] += _p[l] * smallest_alpha;
+            }
+
+            // add constraint to working set, on the constraint exactly
+            const size_t l = smallest_alpha_idx;
+            const size_t j = l%N;
+            if (smallest_alpha_type == BOX) {
+                _W_box[l] = smallest_alpha_sign;
+                u[l] = _W_box[l] > 0 ? _u_up[j] : _u_lo[j];
+            } else {
+                const float prev = l < N ? _u_prev[j] : u[l-N];
+                _W_rate[l] = smallest_alpha_sign;
+                u[l] = prev + (_W_rate[l] > 0 ? _rate[j] : -_rate[j]);
+                // keep the rest of the tied chain on the same step
+                for (size_t k = l + N; k < H*N && _W_rate[k] != 0; k += N) {
+                    u[k] = u[k-N] + (_W_rate[k] > 0 ? _rate[j] : -_rate[j]);
+                }
+            }
+        } else {
+            for (size_t l = 0; l < H*N; l++) {
+                u[l] += _p[l];
+            }
+            // optimal if no constraint in the working set can be released
+            return releaseConstraint(u);
+        }
+
+        return 1;
+    }
+
+    /**
+     * @brief Lagrangian optimality check
+     *
+     * Computes the multipliers of the working set at the minimizer of the
+     * current subspace and removes the constraint with the most negative
+     * multiplier.
+     *
+     * Per actuator, the active constraints of a chain form a path: rate limits
+     * between consecutive samples, anchored by bounds or by the tie to the
+     * last applied command. With a single anchor the multipliers follow from
+     * cumulative sums of the gradient from both ends of the chain. Without an
+     * anchor they are the cumulative sums from the start, the sum over the
+     * whole chain is zero at the minimizer of the subspace. With more anchors
+     * the multipliers between them are not unique, those constraints are
+     * kept.
+     *
+     * @return 0 when optimal, 1 when a constraint was removed
+     */
+    int releaseConstraint(const float u[]) {
+
+        // gradient of the cost, g = A^T * (A * u - b) + rate terms
+        float tolerance = 0.0f;
+        for (size_t j = 0; j < N; j++) {
+            float norm = _w_rate[j] * _w_rate[j];
+            for (size_t i = 0; i < M; i++) {
+                norm += _A[j*M + i] * _A[j*M + i];
+            }
+            tolerance = norm > tolerance ? norm : tolerance;
+        }
+        tolerance *= 1e-4f;
+
+        for (size_t t = 0; t < H; t++) {
+            for (size_t i = 0; i < M; i++) {
+                _r[i] = -_b[t*M + i];
+            }
+            for (size_t l = 0; l < M*N; l++) {
+                _r[l%M] += _A[l] * u[t*N + l/M];
+            }
+            for (size_t j = 0; j < N; j++) {
+                const size_t l = t*N + j;
+                const float w2 = _w_rate[j] * _w_rate[j];
+                float g = w2 * (u[l] - (t == 0 ? _u_prev[j] : u[l-N]));
+                if (t + 1 < H) {
+                    g -= w2 * (u[l+N] - u[l]);
+                }
+                for (size_t i = 0; i < M; i++) {
+                    g += _A[j*M + i] * _r[i];
+                }
+                _p[l] = g;
+            }
+        }
+        const float *g = _p;
+
+        float smallest_lambda = -tolerance;
+        size_t smallest_lambda_idx = 0;
+        int8_t smallest_lambda_type = 0;
+
+        for (size_t j = 0; j < N; j++) {
+            size_t start = 0;
+            while (start < H) {
+                size_t end = start;
+                while (end + 1 < H && _W_rate[(end+1)*N + j] != 0) {
+                    end++;
+                }
+
+                const bool tied = start == 0 && _W_rate[j] != 0;
+                size_t n_anchors = tied ? 1 : 0;
+                size_t anchor = start;
+                for (size_t t = start; t <= end; t++) {
+                    if (_W_box[t*N + j] != 0) {
+                        n_anchors++;
+                        anchor = t;
+                    }
+                }
+
+                if (n_anchors == 0) {
+                    // a free chain of rate limits, signed multipliers from the start
+                    float nu = 0.0f;
+                    for (size_t t = start; t < end; t++) {
+                        nu += g[t*N + j];
+                        checkMultiplier(nu * _W_rate[(t+1)*N + j], (t+1)*N + j, RATE,
+                                        smallest_lambda, smallest_lambda_idx, smallest_lambda_type);
+                    }
+
+                } else if (n_anchors == 1) {
+                    // signed rate multipliers after the anchor, from the end
+                    float nu_after = 0.0f;
+                    for (size_t t = end; t > anchor; t--) {
+                        nu_after -= g[t*N + j];
+                        checkMultiplier(nu_after * _W_rate[t*N + j], t*N + j, RATE,
+                                        smallest_lambda, smallest_lambda_idx, smallest_lambda_type);
+                    }
+
+                    // and before the anchor, from the start
+                    float nu = 0.0f;
+                    for (size_t t = start; t < anchor; t++) {
+                        nu += g[t*N + j];
+                        checkMultiplier(nu * _W_rate[(t+1)*N + j], (t+1)*N + j, RATE,
+                                        smallest_lambda, smallest_lambda_idx, smallest_lambda_type);
+                    }
+
+                    // the anchor balances the rest of the chain
+                    const size_t l = anchor*N + j;
+                    const float beta = -(g[l] + nu - nu_after);
+                    if (_W_box[l] != 0) {
+                        checkMultiplier(beta * _W_box[l], l, BOX,
+                                        smallest_lambda, smallest_lambda_idx, smallest_lambda_type);
+                    } else {
+                        checkMultiplier(beta * _W_rate[l], l, RATE,
+                                        smallest_lambda, smallest_lambda_idx, smallest_lambda_type);
+                    }
+                }
+
+                start = end + 1;
+            }
+        }
+
+        if (smallest_lambda_type == BOX) {
+            _W_box[smallest_lambda_idx] = 0;
+            return 1;
+        } else if (smallest_lambda_type == RATE) {
+            _W_rate[smallest_lambda_idx] = 0;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    static void checkMultiplier(float lambda, size_t idx, int8_t type,
+                                float &smallest_lambda, size_t &smallest_lambda_idx, int8_t &smallest_lambda_type)
+    {
+        if (lambda < smallest_lambda) {
+            smallest_lambda = lambda;
+            smallest_lambda_idx = idx;
+            smallest_lambda_type = type;
+        }
+    }
+
+    /**
+     * @brief Assign the unknowns of the step to the commands
+     *
+     * Commands tied together by active rate limits share one unknown, which
+     * is eliminated at the last sample of the chain. A chain is fixed when a
+     * bound is active on one of its commands, or when it is tied to the last
+     * applied command.
+     */
+    void updateUnknowns() {
+        for (size_t j = 0; j < N; j++) {
+            size_t start = 0;
+            while (start < H) {
+                size_t end = start;
+                bool fixed = _W_box[start*N + j] != 0 || (start == 0 && _W_rate[j] != 0);
+                while (end + 1 < H && _W_rate[(end+1)*N + j] != 0) {
+                    end++;
+                    fixed = fixed || _W_box[end*N + j] != 0;
+                }
+                for (size_t t = start; t <= end; t++) {
+                    _elim[t*N + j] = fixed ? H : end;
+                }
+                start = end + 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Build and decompose the block of sample t
+     *
+     * The columns are the unknowns eliminated at sample t, followed by the
+     * unknowns of sample t+1. The rows are the information left by the block
+     * of sample t-1, the weighted effectiveness of sample t and the rate
+     * weights between sample t and t+1.
+     */
+    int eliminate(size_t t, const float u[]) {
+        const bool last = t + 1 == H;
+
+        // column layout
+        size_t n_elim = 0;
+        for (size_t j = 0; j < N; j++) {
+            if (_elim[t*N + j] == t) {
+                _col_elim[j] = n_elim;
+                _actuator[t][n_elim++] = j;
+            }
+        }
+        size_t n_cols = n_elim;
+        for (size_t j = 0; j < N; j++) {
+            if (!last && _elim[(t+1)*N + j] < H) {
+                _col_next[j] = n_cols;
+                _actuator[t][n_cols++] = j;
+            }
+        }
+        _n_elim[t] = n_elim;
+        _n_cols[t] = n_cols;
+
+        // number of rows
+        size_t n_info = 0;
+        for (size_t j = 0; j < N; j++) {
+            if (_elim[t*N + j] < H) {
+                n_info++;
+            }
+        }
+        size_t n_rate = 0;
+        for (size_t j = 0; j < N; j++) {
+            if (!last && _W_rate[(t+1)*N + j] == 0 && (_elim[t*N + j] < H || _elim[(t+1)*N + j] < H)) {
+                n_rate++;
+            }
+        }
+        const size_t m = n_info + M + n_rate;
+        _rows[t] = m;
+
+        if (n_cols == 0) {
+            return 0;
+        }
+
+        float *block = _block[t];
+        float *rhs = _rhs[t];
+        for (size_t l = 0; l < m*n_cols; l++) {
+            block[l] = 0.0f;
+        }
+
+        size_t row = 0;
+
+        // information about the unknowns of sample t
+        if (t == 0) {
+            // rate weight with respect to the last applied command
+            for (size_t j = 0; j < N; j++) {
+                if (_elim[j] < H) {
+                    block[column(t, j)*m + row] = _w_rate[j];
+                    rhs[row] = -_w_rate[j] * (u[j] - _u_prev[j]);
+                    row++;
+                }
+            }
+        } else {
+            // triangular block left by the previous sample, below the
+            // diagonal the decomposition keeps its Householder vectors
+            const float *prev_block = _block[t-1];
+            const size_t prev_m = _rows[t-1];
+            const size_t prev_elim = _n_elim[t-1];
+            for (size_t r = 0; r < n_info; r++) {
+                for (size_t c = r; c < n_info; c++) {
+                    const size_t j = _actuator[t-1][prev_elim + c];
+                    block[column(t, j)*m + row] = prev_block[(prev_elim + c)*prev_m + prev_elim + r];
+                }
+                rhs[row] = _rhs[t-1][prev_elim + r];
+                row++;
+            }
+        }
+
+        // weighted effectiveness, d = b - A * u
+        for (size_t i = 0; i < M; i++) {
+            rhs[row + i] = _b[t*M + i];
+        }
+        for (size_t l = 0; l < M*N; l++) {
+            rhs[row + l%M] -= _A[l] * u[t*N + l/M];
+        }
+        for (size_t j = 0; j < N; j++) {
+            if (_elim[t*N + j] < H) {
+                for (size_t i = 0; i < M; i++) {
+                    block[column(t, j)*m + row + i] = _A[j*M + i];
+                }
+            }
+        }
+        row += M;
+
+        // rate weight with respect to the next sample
+        for (size_t j = 0; !last && j < N; j++) {
+            const bool live = _elim[t*N + j] < H;
+            const bool live_next = _elim[(t+1)*N + j] < H;
+            if (_W_rate[(t+1)*N + j] == 0 && (live || live_next)) {
+                if (live) {
+                    block[column(t, j)*m + row] = -_w_rate[j];
+                }
+                if (live_next) {
+                    block[_col_next[j]*m + row] = _w_rate[j];
+                }
+                rhs[row] = -_w_rate[j] * (u[(t+1)*N + j] - u[t*N + j]);
+                row++;
+            }
+        }
+
+        if (_solver[t].setMatrix(block, _tau, _w, m, n_cols) < 0) {
+            return -1;
+        }
+        _solver[t].applyQT(rhs, rhs);
+
+        return 0;
+    }
+
+    /**
+     * @brief Solve the unknowns eliminated at sample t
+     */
+    void substitute(size_t t) {
+        const size_t n_elim = _n_elim[t];
+        if (n_elim == 0) {
+            return;
+        }
+
+        const size_t m = _rows[t];
+        const float *block = _block[t];
+        for (size_t i = 0; i < n_elim; i++) {
+            _y[i] = _rhs[t][i];
+        }
+        for (size_t c = n_elim; c < _n_cols[t]; c++) {
+            const size_t j = _actuator[t][c];
+            const float x = _x[_elim[(t+1)*N + j]*N + j];
+            for (size_t i = 0; i < n_elim; i++) {
+                _y[i] -= block[c*m + i] * x;
+            }
+        }
+
+        _solver[t].backSubstitute(_y, n_elim);
+
+        for (size_t c = 0; c < n_elim; c++) {
+            _x[t*N + _actuator[t][c]] = _y[c];
+        }
+    }
+
+    /**
+     * @brief Column of the unknown of actuator j in the block of sample t
+     */
+    size_t column(size_t t, size_t j) const {
+        return _elim[t*N + j] == t ? _col_elim[j] : _col_next[j];
+    }
+
+    void checkActuatorLimits()
+    {
+        for (size_t j = 0; j < N; j++) {
+            if (_u_lo[j] > _u_up[j]) {
+                _u_lo[j] = _u_up[j];
+            }
+        }
+    }
+
+    void applyWeights()
+    {
+        for (size_t l = 0; l < M*N; l++) {
+            _A[l] = _B[l] * _Wv[l%M];
+        }
+    }
+
+    static float clamp(float x, float lo, float up)
+    {
+        return x > up ? up : (x < lo ? lo : x);
+    }
+
+    static const int8_t BOX = 1;
+    static const int8_t RATE = 2;
+
+    /**
+     * @brief Maximum size of a block: information, effectiveness and rate rows
+     */
+    static const size_t ROWS = 2*N + M;
+    static const size_t COLS = 2*N;
+
+    /**
+     * @brief Control effectiveness matrix, column major
+     */
+    float _B[M*N];
+    float _Wv[M];
+    float _A[M*N]; // this is just B with applied weights
+    float _u_up[N];
+    float _u_lo[N];
+    float _rate[N];
+    float _w_rate[N];
+
+    float _u_prev[N];
+    float _b[H*M];
+    float _p[H*N];
+    float _r[M];
+
+    int8_t _W_box[H*N];
+    int8_t _W_rate[H*N];
+
+    /**
+     * @brief Sample at which the unknown of each command is eliminated, H if fixed
+     */
+    size_t _elim[H*N];
+
+    /**
+     * @brief Value of the unknowns, by the sample at which they are eliminated
+     */
+    float _x[H*N];
+
+    float _block[H][ROWS*COLS];
+    float _rhs[H][ROWS];
+    size_t _actuator[H][COLS];
+    size_t _rows[H];
+    size_t _n_elim[H];
+    size_t _n_cols[H];
+
+    size_t _col_elim[N];
+    size_t _col_next[N];
+
+    // working space for the solvers
+    float _tau[COLS];
+    float _w[ROWS];
+    float _y[ROWS];
+
+    LeastSquaresSolver _solver[H];
+};
+
+} // namespace ifl_control
@@ -0,0 +1,230 @@
+/**
+ * @file IndiController.hpp
+ *
+ * Incremental Nonlinear Dynamic Inversion (INDI) stage of the inner loop.
+ *
+ * INDI only inverts the actuator effectiveness around the current state. The
+ * angular acceleration error is turned into an increment of the actuator
+ * commands, which is added to the filtered actuator feedback. The increment is
+ * allocated by the ActiveSetAlgorithm, with the actuator limits shifted by the
+ * filtered actuator state.
+ *
+ * The measured angular acceleration and the actuator feedback can be passed
+ * through a single BiquadFilterBank, which applies the same low-pass filter to
+ * all M + N channels, so they arrive at the allocator synchronized. The
+ * increments of these filtered signals can drive an EffectivenessEstimator,
+ * which corrects the effectiveness of the allocator online.
+ *
+ * All buffers are members of the class, so an update does not allocate.
+ */
+
+#pragma once
+
+#include "ActiveSetAlgorithm.hpp"
+#include "BiquadFilterBank.hpp"
+#include "EffectivenessEstimator.hpp"
+
+namespace ifl_control {
+
+/**
+ * @brief The IndiController class
+ *
+ * M is the number of controlled axes, N the number of actuators.
+ * The effectiveness matrix maps an increment of the actuator commands to an
+ * increment of the angular acceleration (and thrust, when included in M).
+ */
+template<size_t M, size_t N>
+class IndiController
+{
+public:
+    IndiController() :
+        _u_up{},
+        _u_lo{},
+        _du{},
+        _du_up{},
+        _du_lo{},
+        _filter_in{},
+        _accel_error{},
+        _filter_delta{}
+    {
+
+    }
+
+    int setActuatorEffectiveness(const float B_row_major[]) {
+        return _allocator.setActuatorEffectiveness(B_row_major);
+    }
+
+    int setOutputWeights(const float Wv[]) {
+        return _allocator.setOutputWeights(Wv);
+    }
+
+    int setActuatorUpperLimit(const float u_up[]) {
+        for (size_t j = 0; j < N; j++) {
+            _u_up[j] = u_up[j];
+        }
+        return 0;
+    }
+
+    int setActuatorLowerLimit(const float u_lo[]) {
+        for (size_t j = 0; j < N; j++) {
+            _u_lo[j] = u_lo[j];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Run one tick of the INDI inner loop
+     *
+     * @param accel_error Angular acceleration error, reference minus filtered (M)
+     * @param u_f Filtered actuator state, synchronized with the acceleration (N)
+     * @param u_out Actuator commands (N)
+     * @param max_iterations Maximum number of active set iterations
+     */
+    int update(const float accel_error[], const float u_f[], float u_out[], size_t max_iterations) {
+
+        // incremental bounds
+        for (size_t j = 0; j < N; j++) {
+            _du_up[j] = _u_up[j] - u_f[j];
+            _du_lo[j] = _u_lo[j] - u_f[j];
+            _du[j] = 0.0f;
+        }
+        _allocator.setActuatorUpperLimit(_du_up);
+        _allocator.setActuatorLowerLimit(_du_lo);
+
+        int ret = _allocator.calculateActuatorCommands(accel_error, _du, max_iterations);
+
+        for (size_t j = 0; j < N; j++) {
+            u_out[j] = u_f[j] + _du[j];
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Configure the synchronization filter of the measurements
+     */
+    int setFilterLowPass(float sample_freq, float cutoff_freq) {
+        return _filter.setLowPass(sample_freq, cutoff_freq);
+    }
+
+    /**
+     * @brief Reset the synchronization filter to constant measurements
+     */
+    void resetFilter(const float accel[], const float u_meas[]) {
+        packMeasurements(accel, u_meas);
+        _filter.reset(_filter_in);
+        for (size_t c = 0; c < M + N; c++) {
+            _filter_out[c] = _filter_in[c];
+        }
+        _filter_valid = true;
+    }
+
+    /**
+     * @brief Enable online estimation of the effectiveness, see EffectivenessEstimator
+     */
+    int setEffectivenessLearningRate(const float mu[]) {
+        if (_estimator.setLearningRate(mu) < 0) {
+            return -1;
+        }
+        _estimate = true;
+        return 0;
+    }
+
+    int setEffectivenessForgettingFactor(float lambda) {
+        return _estimator.setForgettingFactor(lambda);
+    }
+
+    int setEffectivenessMinimumExcitation(float excitation) {
+        return _estimator.setMinimumExcitation(excitation);
+    }
+
+    /**
+     * @brief Current effectiveness matrix of the allocator, column major
+     */
+    const float *getActuatorEffectiveness() const {
+        return _allocator.getActuatorEffectiveness();
+    }
+
+    /**
+     * @brief Run one tick of the INDI inner loop from raw measurements
+     *
+     * The measured angular acceleration and actuator feedback are filtered
+     * by the same filter bank before they enter the allocation.
+     *
+     * @param accel_ref Reference angular acceleration (M)
+     * @param accel Measured angular acceleration, e.g. the gyro derivative (M)
+     * @param u_meas Measured actuator state (N)
+     * @param u_out Actuator commands (N)
+     * @param max_iterations Maximum number of active set iterations
+     */
+    int update(const float accel_ref[], const float accel[], const float u_meas[], float u_out[],
+               size_t max_iterations) {
+        packMeasurements(accel, u_meas);
+
+        // keep the previous filter output for the increments
+        for (size_t c = 0; c < M + N; c++) {
+            _filter_delta[c] = -_filter_out[c];
+        }
+
+        _filter.update(_filter_in, _filter_out);
+
+        if (_estimate && _filter_valid) {
+            for (size_t c = 0; c < M + N; c++) {
+                _filter_delta[c] += _filter_out[c];
+            }
+            _estimator.update(&_filter_delta[M], _filter_delta, _allocator);
+        }
+        _filter_valid = true;
+
+        for (size_t i = 0; i < M; i++) {
+            _accel_error[i] = accel_ref[i] - _filter_out[i];
+        }
+
+        return update(_accel_error, &_filter_out[M], u_out, max_iterations);
+    }
+
+    /**
+     * @brief Actuator increment of the last update
+     */
+    const float *getIncrement() const {
+        return _du;
+    }
+
+private:
+    void packMeasurements(const float accel[], const float u_meas[]) {
+        for (size_t i = 0; i < M; i++) {
+            _filter_in[i] = accel[i];
+        }
+        for (size_t j = 0; j < N; j++) {
+            _filter_in[M + j] = u_meas[j];
+        }
+    }
+
+    ActiveSetAlgorithm<M, N> _allocator;
+
+    float _u_up[N];
+    float _u_lo[N];
+
+    float _du[N];
+    float _du_up[N];
+    float _du_lo[N];
+
+    /**
+     * @brief Filter for the angular acceleration (first M) and actuators (last N)
+     */
+    BiquadFilterBank<M + N, 2> _filter;
+    float _filter_in[M + N];
+    float _filter_out[M + N] = {};
+    float _accel_error[M];
+
+    /**
+     * @brief Increment of the filter output over the last tick
+     */
+    float _filter_delta[M + N];
+    bool _filter_valid = false;
+
+    EffectivenessEstimator<M, N> _estimator;
+    bool _estimate = false;
+};
+
+} // namespace ifl_control
@@ -8,6 +8,23 @@
  *
  * It will calculate the pseudo-inverse when there are more columns than rows.
  *
+ * Optionally, a sparsity pattern can be supplied with the matrix. This is a
+ * bitmask per column, where bit i is set when row i may hold a non-zero value.
+ * The kernels walk only the set bits of the pattern, so rows outside of it
+ * cost nothing in the decomposition and the solver.
+ * The decomposition adds its fill-in to the pattern, so it stays valid for the
+ * factorized matrix.
+ *
+ * With column pivoting, the decomposition reveals the numerical rank of the
+ * matrix. Columns that are (nearly) linear combinations of the others are
+ * moved to the back, and the upper triangle is reduced further to a complete
+ * orthogonal decomposition
+ *
+ *   A * P = Q * [T 0; 0 0] * Z
+ *
+ * with T of full rank. The solver then returns the minimum norm solution,
+ * which spreads the effort evenly over redundant columns.
+ *
  * @author Bart Slinger <bartslinger@gmail.com>
  */
 
@@ -18,103 +35,463 @@ namespace ifl_control {
 class LeastSquaresSolver
 {
 public:
+    /**
+     * @brief Maximum number of rows that fit in a column sparsity pattern
+     */
+    static const size_t MAX_PATTERN_ROWS = 32;
+
+    /**
+     * @brief Index of the lowest set bit of a non-zero row bitmask
+     *
+     * Loop over the rows of a pattern with
+     * for (; rows != 0; rows &= rows - 1u) { size_t i = lowestRow(rows); }
+     */
+    static size_t lowestRow(uint32_t rows)
+    {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctz(rows));
+#else
+        size_t i = 0;
+        while (((rows >> i) & 1u) == 0) {
+            i++;
+        }
+        return i;
+#endif
+    }
+
     LeastSquaresSolver() = default;
 
-    int setMatrix(float *A, float *tau, float *w, size_t m, size_t n)
+    int setMatrix(float *A, float *tau, float *w, size_t m, size_t n, uint32_t *pattern = nullptr)
     {
+        if (pattern != nullptr && m > MAX_PATTERN_ROWS) {
+            return -1;
+        }
+
         _A = A;
         _tau = tau;
         _w = w;
         _m = m;
         _n = n;
+        _pattern = pattern;
+        _perm = nullptr;
+        _rank = n;
 
         // Perform the QR decomposition
-        if (decomposeQR() < 0) {
+        if (decomposeQR(A, tau, pattern, nullptr) < 0) {
             return -1;
         }
 
         return 0;
     }
 
-    int solve(const float b[], float x_out[])
+    /**
+     * @brief Decompose with column pivoting and rank detection
+     *
+     * At every step, the remaining column with the largest norm is moved to
+     * the front. The decomposition stops when that norm drops below the rank
+     * tolerance, relative to the first one. The columns after getRank() are
+     * numerically redundant. They are eliminated from the upper triangle with
+     * Householder reflections from the right, so solve() returns the minimum
+     * norm solution. This also works with more columns than rows.
+     *
+     * @param tau Scaling of the reflections (2 * min(m, n))
+     * @param w Working space (max(m, n))
+     * @param perm Column permutation (n), column j of the decomposition is column perm[j] of A
+     */
+    int setMatrixPivoted(float *A, float *tau, float *w, size_t *perm, size_t m, size_t n,
+                         uint32_t *pattern = nullptr)
     {
-        // copy b to x_out
-        for (size_t i = 0; i < _m; i++) {
-            x_out[i] = b[i];
+        if (pattern != nullptr && m > MAX_PATTERN_ROWS) {
+            return -1;
         }
 
-        for (size_t j = 0; j < _n; j++) {
-            for (size_t i = j+1; i < _m; i++) {
-                _w[i-j] = _A[j*_m + i];
+        _A = A;
+        _tau = tau;
+        _w = w;
+        _m = m;
+        _n = n;
+        _pattern = pattern;
+        _perm = perm;
+        _rank = n;
+
+        for (size_t j = 0; j < n; j++) {
+            perm[j] = j;
+        }
+
+        return decomposeQR(A, tau, pattern, perm);
+    }
+
+    /**
+     * @brief Use a decomposition from an earlier call to setMatrixPivoted()
+     *
+     * The decomposed matrix, tau and pattern are only read, so one
+     * decomposition can be shared by several solvers. Each solver needs its
+     * own w, of max(m, n) elements.
+     */
+    int setDecomposition(const float *A, const float *tau, const size_t *perm, size_t rank, float *w,
+                         size_t m, size_t n, const uint32_t *pattern = nullptr)
+    {
+        if (pattern != nullptr && m > MAX_PATTERN_ROWS) {
+            return -1;
+        }
+
+        _A = A;
+        _tau = tau;
+        _w = w;
+        _w[0] = 1.0f;
+        _m = m;
+        _n = n;
+        _pattern = pattern;
+        _perm = perm;
+        _rank = perm != nullptr ? rank : n;
+        return 0;
+    }
+
+    /**
+     * @brief Relative tolerance on the pivots of setMatrixPivoted()
+     */
+    int setRankTolerance(float tolerance)
+    {
+        if (tolerance < 0.0f || tolerance >= 1.0f) {
+            return -1;
+        }
+        _rank_tolerance = tolerance;
+        return 0;
+    }
+
+    /**
+     * @brief Number of columns in the decomposition
+     */
+    size_t getRank() const
+    {
+        return _rank;
+    }
+
+    /**
+     * @brief Solve the least squares problem
+     *
+     * x_out needs space for the larger of m and n elements. With pivoting,
+     * this is the solution with the smallest norm.
+     */
+    int solve(const float b[], float x_out[])
+    {
+        applyQT(b, x_out);
+        backSubstitute(x_out, _rank);
+
+        if (_perm != nullptr) {
+            // x = Z^T * [T^-1 * c; 0]
+            for (size_t j = _rank; j < _n; j++) {
+                x_out[j] = 0.0f;
             }
-            float tmp = 0.0f;
-            for (size_t i = j; i < _m; i++) {
-                tmp += _w[i-j] * x_out[i];
+            if (_rank < _n) {
+                for (size_t i = 0; i < _rank; i++) {
+                    reflectRZ(i, x_out);
+                }
             }
 
-            for (size_t i = j; i < _m; i++) {
-                x_out[i] -= _tau[j] * _w[i-j] * tmp;
+            // undo the column permutation, w is free until the next applyQT
+            for (size_t j = 0; j < _n; j++) {
+                _w[j] = x_out[j];
             }
+            for (size_t j = 0; j < _n; j++) {
+                x_out[_perm[j]] = _w[j];
+            }
+            _w[0] = 1.0f;
         }
+        return 0;
+    }
 
-        for (size_t l = _n; l > 0; l--) {
-            size_t i = l - 1;
-            for (size_t r = i+1; r < _n; r++) {
-                x_out[i] -= _A[r*_m + i] * x_out[r];
+    /**
+     * @brief Apply the transpose of Q from the decomposition, y = Q^T * b
+     *
+     * Both b and y have m elements, they can be the same array.
+     */
+    int applyQT(const float b[], float y[])
+    {
+        // copy b to y
+        for (size_t i = 0; i < _m; i++) {
+            y[i] = b[i];
+        }
+
+        for (size_t j = 0; j < _rank; j++) {
+            if (_pattern == nullptr) {
+                for (size_t i = j+1; i < _m; i++) {
+                    _w[i-j] = _A[j*_m + i];
+                }
+            } else {
+                for (uint32_t rows = (_pattern[j] >> j) & ~1u; rows != 0; rows &= rows - 1u) {
+                    size_t l = lowestRow(rows);
+                    _w[l] = _A[j*_m + j + l];
+                }
             }
+            reflect(j, _tau[j], y);
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Solve R * x = y in place for the leading n by n block of R
+     *
+     * This allows to solve for the first n columns only, when the remaining
+     * columns have been moved to the right hand side. R is processed column
+     * by column, so the pattern of each column gives the rows to update.
+     */
+    int backSubstitute(float x[], size_t n) const
+    {
+        for (size_t l = n; l > 0; l--) {
+            size_t i = l - 1;
             if (abs(_A[i*_m + i]) < 1e-8f) {
                 // fill output with zeros
-                for (size_t z = 0; z < _n; z++) {
-                    x_out[z] = 0.0f;
+                for (size_t z = 0; z < n; z++) {
+                    x[z] = 0.0f;
+                }
+            }
+            x[i] /= _A[i*_m + i];
+
+            // eliminate x[i] from the rows above
+            if (_pattern == nullptr) {
+                for (size_t r = 0; r < i; r++) {
+                    x[r] -= _A[i*_m + r] * x[i];
+                }
+            } else {
+                for (uint32_t rows = _pattern[i] & ((1u << i) - 1u); rows != 0; rows &= rows - 1u) {
+                    size_t r = lowestRow(rows);
+                    x[r] -= _A[i*_m + r] * x[i];
                 }
             }
-            x_out[i] /= _A[i*_m + i];
         }
 
         return 0;
     }
 
 private:
-    int decomposeQR() {
+    int decomposeQR(float *A, float *tau, uint32_t *pattern, size_t *perm) {
         _w[0] = 1.0f;
+        float first_pivot = 0.0f;
         for (size_t j = 0; j < _n; j++) {
-            float normx = 0.0f;
-            for (size_t i = j; i < _m; i++) {
-                size_t idx = j*_m + i;
-                normx += _A[idx] * _A[idx];
+            if (perm != nullptr) {
+                float pivot = pivotColumn(A, pattern, perm, j);
+                if (j == 0) {
+                    first_pivot = pivot;
+                }
+                if (pivot < 1e-8f || pivot <= _rank_tolerance * first_pivot) {
+                    // the remaining columns are numerically redundant
+                    _rank = j;
+                    break;
+                }
+            }
+
+            // rows touched by this Householder reflection
+            uint32_t reflection = 0;
+            if (pattern != nullptr) {
+                pattern[j] |= 1u << j;
+                reflection = pattern[j] & ~((1u << j) - 1u);
             }
-            normx = sqrt(normx);
-            float s = _A[j*_m + j] > 0.0f ? -1.0f : 1.0f;
-            float u1 = _A[j*_m + j] - s*normx;
+
+            float normx = sqrt(columnNorm2(A, j, j));
+            float s = A[j*_m + j] > 0.0f ? -1.0f : 1.0f;
+            float u1 = A[j*_m + j] - s*normx;
             if (normx < 1e-8f) {
                 return -1;
             }
-            for (size_t i = j+1; i < _m; i++) {
-                _w[i-j] = _A[j*_m + i] / u1;
-                _A[j*_m + i] = _w[i-j];
+            if (pattern == nullptr) {
+                for (size_t i = j+1; i < _m; i++) {
+                    _w[i-j] = A[j*_m + i] / u1;
+                    A[j*_m + i] = _w[i-j];
+                }
+            } else {
+                for (uint32_t rows = (reflection >> j) & ~1u; rows != 0; rows &= rows - 1u) {
+                    size_t l = lowestRow(rows);
+                    _w[l] = A[j*_m + j + l] / u1;
+                    A[j*_m + j + l] = _w[l];
+                }
             }
-            _A[j*_m + j] = s*normx;
-            _tau[j] = -s*u1/normx;
+            A[j*_m + j] = s*normx;
+            tau[j] = -s*u1/normx;
 
             for (size_t k = j+1; k < _n; k++) {
-                float tmp = 0.0f;
-                for (size_t i = j; i < _m; i++) {
-                    tmp += _w[i-j] * _A[k*_m + i];
-                }
-                for (size_t i = j; i < _m; i++) {
-                    _A[k*_m + i] -= _tau[j] * _w[i-j] * tmp;
+                if (pattern != nullptr) {
+                    if ((pattern[k] & reflection) == 0) {
+                        // column has no overlap with the reflection, it is unchanged
+                        continue;
+                    }
+                    // fill-in
+                    pattern[k] |= reflection;
                 }
+                reflect(j, tau[j], &A[k*_m]);
             }
         }
 
+        if (perm != nullptr && _rank < _n) {
+            decomposeRZ(A, tau, pattern);
+        }
+
         return 0;
     }
 
-    float *_A = nullptr;
-    float *_tau = nullptr;
+    /**
+     * @brief Reduce [R11 R12] to [T 0] with reflections from the right
+     *
+     * Reflection i acts on column i and the redundant columns. It eliminates
+     * row i of R12, which then holds its Householder vector, without the
+     * leading one. Its tau is stored at tau[rank + i].
+     */
+    void decomposeRZ(float *A, float *tau, uint32_t *pattern)
+    {
+        const size_t r = _rank;
+        for (size_t l = r; l > 0; l--) {
+            const size_t i = l - 1;
+            float norm_r12 = 0.0f;
+            for (size_t c = r; c < _n; c++) {
+                norm_r12 += A[c*_m + i] * A[c*_m + i];
+            }
+            if (!(norm_r12 > 0.0f)) {
+                // row is already reduced
+                tau[r + i] = 0.0f;
+                continue;
+            }
+
+            const float alpha = A[i*_m + i];
+            const float normx = sqrt(alpha * alpha + norm_r12);
+            const float s = alpha > 0.0f ? -1.0f : 1.0f;
+            const float u1 = alpha - s*normx;
+            for (size_t c = r; c < _n; c++) {
+                A[c*_m + i] /= u1;
+            }
+            A[i*_m + i] = s*normx;
+            tau[r + i] = -s*u1/normx;
+
+            // rows above i, their part of R12 is not reduced yet
+            for (size_t row = 0; row < i; row++) {
+                float tmp = A[i*_m + row];
+                for (size_t c = r; c < _n; c++) {
+                    tmp += A[c*_m + i] * A[c*_m + row];
+                }
+                tmp *= tau[r + i];
+                A[i*_m + row] -= tmp;
+                for (size_t c = r; c < _n; c++) {
+                    A[c*_m + row] -= tmp * A[c*_m + i];
+                }
+            }
+
+            // fill-in of column i of T
+            if (pattern != nullptr) {
+                pattern[i] |= (2u << i) - 1u;
+            }
+        }
+    }
+
+    /**
+     * @brief Apply reflection i of the RZ step to the vector y (n)
+     */
+    void reflectRZ(size_t i, float y[]) const
+    {
+        float tmp = y[i];
+        for (size_t c = _rank; c < _n; c++) {
+            tmp += _A[c*_m + i] * y[c];
+        }
+        tmp *= _tau[_rank + i];
+        y[i] -= tmp;
+        for (size_t c = _rank; c < _n; c++) {
+            y[c] -= tmp * _A[c*_m + i];
+        }
+    }
+
+    /**
+     * @brief Move the column with the largest norm below row j to column j
+     *
+     * @return Norm of the new column j below row j
+     */
+    float pivotColumn(float *A, uint32_t *pattern, size_t *perm, size_t j)
+    {
+        size_t pivot = j;
+        float pivot_norm = 0.0f;
+        for (size_t c = j; c < _n; c++) {
+            float norm = columnNorm2(A, c, j);
+            if (norm > pivot_norm) {
+                pivot = c;
+                pivot_norm = norm;
+            }
+        }
+
+        if (pivot != j) {
+            for (size_t i = 0; i < _m; i++) {
+                float tmp = A[j*_m + i];
+                A[j*_m + i] = A[pivot*_m + i];
+                A[pivot*_m + i] = tmp;
+            }
+            if (pattern != nullptr) {
+                uint32_t tmp = pattern[j];
+                pattern[j] = pattern[pivot];
+                pattern[pivot] = tmp;
+            }
+            size_t tmp = perm[j];
+            perm[j] = perm[pivot];
+            perm[pivot] = tmp;
+        }
+
+        return sqrt(pivot_norm);
+    }
+
+    /**
+     * @brief Squared norm of a column of A, from row first down
+     */
+    float columnNorm2(const float *A, size_t column, size_t first) const
+    {
+        const float *a = &A[column*_m];
+        float norm = 0.0f;
+        if (first >= _m) {
+            return norm;
+        }
+        if (_pattern == nullptr) {
+            for (size_t i = first; i < _m; i++) {
+                norm += a[i] * a[i];
+            }
+        } else {
+            for (uint32_t rows = _pattern[column] >> first << first; rows != 0; rows &= rows - 1u) {
+                size_t i = lowestRow(rows);
+                norm += a[i] * a[i];
+            }
+        }
+        return norm;
+    }
+
+    /**
+     * @brief Apply Householder reflection j, held in w, to the vector y (m)
+     */
+    void reflect(size_t j, float tau, float y[]) const
+    {
+        float tmp = 0.0f;
+        if (_pattern == nullptr) {
+            for (size_t i = j; i < _m; i++) {
+                tmp += _w[i-j] * y[i];
+            }
+            for (size_t i = j; i < _m; i++) {
+                y[i] -= tau * _w[i-j] * tmp;
+            }
+        } else {
+            const uint32_t reflection = _pattern[j] >> j;
+            for (uint32_t rows = reflection; rows != 0; rows &= rows - 1u) {
+                size_t l = lowestRow(rows);
+                tmp += _w[l] * y[j + l];
+            }
+            for (uint32_t rows = reflection; rows != 0; rows &= rows - 1u) {
+                size_t l = lowestRow(rows);
+                y[j + l] -= tau * _w[l] * tmp;
+            }
+        }
+    }
+
+    const float *_A = nullptr;
+    const float *_tau = nullptr;
     float *_w = nullptr;
     size_t _m = 0;
     size_t _n = 0;
+    const uint32_t *_pattern = nullptr;
+    const size_t *_perm = nullptr;
+    size_t _rank = 0;
+    float _rank_tolerance = 1e-6f;
 };
 
 } // namespace ifl_control
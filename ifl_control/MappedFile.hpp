@@ -0,0 +1,79 @@
+/**
+ * @file MappedFile.hpp
+ *
+ * Read-only memory mapping of a file, for example an AirframeDatabase.
+ *
+ * Only available on POSIX systems.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ifl_control {
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    int open(const char *path)
+    {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return -1;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+            ::close(fd);
+            return -1;
+        }
+
+        void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return -1;
+        }
+
+        _data = data;
+        _size = static_cast<size_t>(st.st_size);
+        return 0;
+    }
+
+    void close()
+    {
+        if (_data != nullptr) {
+            munmap(_data, _size);
+            _data = nullptr;
+            _size = 0;
+        }
+    }
+
+    const void *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    void *_data = nullptr;
+    size_t _size = 0;
+};
+
+} // namespace ifl_control
@@ -0,0 +1,131 @@
+"""Python binding of the ifl_control allocator.
+
+Solves batches of allocation problems with the C++ ActiveSetAlgorithm,
+through the C interface in ifl_control_c.h. Build the library with
+
+    cmake -S . -B build -DPYTHON=ON && cmake --build build
+
+and point IFL_CONTROL_LIBRARY to build/python/libifl_control_c.so, or keep
+the library next to this file.
+
+The NumPy arrays are passed to the library without copying when they are
+float32 and aligned, their rows are contiguous and the row stride is a
+non-negative multiple of the element size. Other arrays are copied. A
+single row of bounds, or a broadcast one, is shared by all problems. The
+call releases the GIL, so batches can be solved from several threads.
+
+Example:
+
+    u, status, iterations = ifl_control.allocate(B, Wv, v, u_lo, u_up)
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+CONVERGED = 0
+MAX_ITERATIONS = 1
+
+_float_p = ctypes.POINTER(ctypes.c_float)
+
+
+def _load_library():
+    path = os.environ.get('IFL_CONTROL_LIBRARY')
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libifl_control_c.so')
+
+    # CDLL releases the GIL during the call
+    library = ctypes.CDLL(path)
+    library.ifl_control_allocate_batch.restype = ctypes.c_int
+    library.ifl_control_allocate_batch.argtypes = [
+        ctypes.c_size_t, ctypes.c_size_t, _float_p, _float_p,
+        ctypes.c_size_t,
+        _float_p, ctypes.c_size_t,
+        _float_p, ctypes.c_size_t,
+        _float_p, ctypes.c_size_t,
+        _float_p, ctypes.c_size_t,
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_int32), ctypes.POINTER(ctypes.c_uint32)]
+    return library
+
+
+_library = None
+
+
+def _batch(array, count, columns, name):
+    """Float32 array of count rows, returns the array and its row stride in elements."""
+    array = np.asarray(array)
+    if array.dtype != np.float32:
+        array = array.astype(np.float32)
+    if array.ndim == 1:
+        array = array[np.newaxis, :]
+    if array.ndim != 2 or array.shape[1] != columns or array.shape[0] not in (1, count):
+        raise ValueError('%s must have shape (%d,) or (%d, %d)' % (name, columns, count, columns))
+    if array.shape[0] == 1:
+        if array.strides[1] != array.itemsize or not array.flags.aligned:
+            array = np.ascontiguousarray(array)
+        return array, 0
+    # the library takes a non-negative row stride in whole elements
+    if (array.strides[1] != array.itemsize or array.strides[0] < 0
+            or array.strides[0] % array.itemsize != 0 or not array.flags.aligned):
+        array = np.ascontiguousarray(array)
+    return array, array.strides[0] // array.itemsize
+
+
+def _pointer(array):
+    return array.ctypes.data_as(_float_p)
+
+
+def allocate(B, Wv, v, u_lo, u_up, u0=None, max_iterations=10):
+    """Allocate every row of v with the effectiveness B and output weights Wv.
+
+    Args:
+        B: Effectiveness matrix, shape (m, n).
+        Wv: Output weights, shape (m,).
+        v: Desired outputs, shape (count, m).
+        u_lo, u_up: Actuator bounds, shape (n,) or (count, n).
+        u0: Initial actuator commands, shape (n,) or (count, n), zero if None.
+        max_iterations: Maximum number of iterations per problem.
+
+    Returns:
+        u: Actuator commands, shape (count, n), float32.
+        status: CONVERGED or MAX_ITERATIONS per problem.
+        iterations: Number of iterations per problem.
+    """
+    global _library
+    if _library is None:
+        _library = _load_library()
+
+    B = np.ascontiguousarray(B, dtype=np.float32)
+    Wv = np.ascontiguousarray(Wv, dtype=np.float32)
+    if B.ndim != 2 or Wv.shape != (B.shape[0],):
+        raise ValueError('B must have shape (m, n) and Wv shape (m,)')
+    m, n = B.shape
+
+    v = np.asarray(v)
+    count = 1 if v.ndim == 1 else v.shape[0]
+    v, v_stride = _batch(v, count, m, 'v')
+    u_lo, u_lo_stride = _batch(u_lo, count, n, 'u_lo')
+    u_up, u_up_stride = _batch(u_up, count, n, 'u_up')
+
+    u = np.zeros((count, n), dtype=np.float32)
+    if u0 is not None:
+        u[:] = u0
+    status = np.empty(count, dtype=np.int32)
+    iterations = np.empty(count, dtype=np.uint32)
+
+    ret = _library.ifl_control_allocate_batch(
+        m, n, _pointer(B), _pointer(Wv),
+        count,
+        _pointer(v), v_stride,
+        _pointer(u_lo), u_lo_stride,
+        _pointer(u_up), u_up_stride,
+        _pointer(u), n,
+        max_iterations,
+        status.ctypes.data_as(ctypes.POINTER(ctypes.c_int32)),
+        iterations.ctypes.data_as(ctypes.POINTER(ctypes.c_uint32)))
+    if ret < 0:
+        raise ValueError('unsupported dimensions or invalid arguments')
+
+    return u, status, iterations
@@ -0,0 +1,114 @@
+/**
+ * @file ifl_control_c.cpp
+ *
+ * Implementation of the C interface. The problem dimensions are template
+ * parameters of the allocator, so every supported combination of m and n is
+ * instantiated and selected at runtime.
+ */
+
+#include "ifl_control_c.h"
+
+#include "ifl_control/stdlib_imports.hpp"
+#include "ifl_control/ActiveSetAlgorithm.hpp"
+
+using namespace ifl_control;
+
+namespace {
+
+struct Batch {
+    const float *B_row_major;
+    const float *Wv;
+    size_t count;
+    const float *v;
+    size_t v_stride;
+    const float *u_lo;
+    size_t u_lo_stride;
+    const float *u_up;
+    size_t u_up_stride;
+    float *u;
+    size_t u_stride;
+    size_t max_iterations;
+    int32_t *status;
+    uint32_t *iterations;
+};
+
+template<size_t M, size_t N>
+int allocateBatch(const Batch &batch)
+{
+    AllocatorConfiguration<M, N> configuration;
+    configuration.setActuatorEffectiveness(batch.B_row_major);
+    configuration.setOutputWeights(batch.Wv);
+
+    ActiveSetWorkspace<M, N> workspace;
+    for (size_t k = 0; k < batch.count; k++) {
+        float *u = &batch.u[k * batch.u_stride];
+        workspace.setActuatorLowerLimit(&batch.u_lo[k * batch.u_lo_stride]);
+        workspace.setActuatorUpperLimit(&batch.u_up[k * batch.u_up_stride]);
+        workspace.calculateActuatorCommands(configuration, &batch.v[k * batch.v_stride], u, batch.max_iterations);
+
+        batch.status[k] = workspace.hasConverged() ? IFL_CONTROL_CONVERGED : IFL_CONTROL_MAX_ITERATIONS;
+        batch.iterations[k] = static_cast<uint32_t>(workspace.getIterationCount());
+    }
+    return 0;
+}
+
+/**
+ * @brief Find the instantiation for m and n, counting down from M and N
+ */
+template<size_t M, size_t N>
+struct Dispatch {
+    static int run(size_t m, size_t n, const Batch &batch)
+    {
+        if (m == M && n == N) {
+            return allocateBatch<M, N>(batch);
+        }
+        return Dispatch<M, N - 1>::run(m, n, batch);
+    }
+};
+
+template<size_t M>
+struct Dispatch<M, 0> {
+    static int run(size_t m, size_t n, const Batch &batch)
+    {
+        return Dispatch<M - 1, IFL_CONTROL_MAX_ACTUATORS>::run(m, n, batch);
+    }
+};
+
+template<size_t N>
+struct Dispatch<0, N> {
+    static int run(size_t m, size_t n, const Batch &batch)
+    {
+        return -1;
+    }
+};
+
+} // namespace
+
+int ifl_control_allocate_batch(size_t m, size_t n, const float *B_row_major, const float *Wv,
+                               size_t count,
+                               const float *v, size_t v_stride,
+                               const float *u_lo, size_t u_lo_stride,
+                               const float *u_up, size_t u_up_stride,
+                               float *u, size_t u_stride,
+                               size_t max_iterations,
+                               int32_t *status, uint32_t *iterations)
+{
+    if (m == 0 || m > IFL_CONTROL_MAX_OUTPUTS || n == 0 || n > IFL_CONTROL_MAX_ACTUATORS) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (B_row_major == nullptr || Wv == nullptr || v == nullptr || u_lo == nullptr || u_up == nullptr
+        || u == nullptr || status == nullptr || iterations == nullptr) {
+        return -1;
+    }
+    if (count > 1 && u_stride == 0) {
+        return -1;
+    }
+
+    Batch batch = {B_row_major, Wv, count, v, v_stride, u_lo, u_lo_stride, u_up, u_up_stride, u, u_stride,
+                   max_iterations, status, iterations
+                  };
+    return Dispatch<IFL_CONTROL_MAX_OUTPUTS, IFL_CONTROL_MAX_ACTUATORS>::run(m, n, batch);
+}
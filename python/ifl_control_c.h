@@ -0,0 +1,72 @@
+/**
+ * @file ifl_control_c.h
+ *
+ * C interface to the allocator, for offline analysis from other languages.
+ *
+ * A batch of allocation problems with the same effectiveness matrix and
+ * output weights is solved with one shared AllocatorConfiguration. The batch
+ * arrays are read and written in place. Their rows are count vectors of m or
+ * n floats, row i starts at element i * stride. A stride of zero uses the
+ * same row for every problem.
+ *
+ * The function does not touch global state, so batches can be solved from
+ * several threads at the same time.
+ */
+
+#ifndef IFL_CONTROL_C_H
+#define IFL_CONTROL_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest number of outputs and actuators of a batch
+ */
+#define IFL_CONTROL_MAX_OUTPUTS 6
+#define IFL_CONTROL_MAX_ACTUATORS 16
+
+/**
+ * @brief Status of a single problem
+ */
+#define IFL_CONTROL_CONVERGED 0
+#define IFL_CONTROL_MAX_ITERATIONS 1
+
+/**
+ * @brief Solve a batch of allocation problems with the active set algorithm
+ *
+ * @param m Number of outputs
+ * @param n Number of actuators
+ * @param B_row_major Effectiveness matrix (m*n)
+ * @param Wv Output weights (m)
+ * @param count Number of problems
+ * @param v Desired outputs (count rows of m)
+ * @param v_stride Row stride of v, in elements
+ * @param u_lo Lower actuator bounds (count rows of n)
+ * @param u_lo_stride Row stride of u_lo, in elements
+ * @param u_up Upper actuator bounds (count rows of n)
+ * @param u_up_stride Row stride of u_up, in elements
+ * @param u Initial actuator commands, overwritten by the solution (count rows of n)
+ * @param u_stride Row stride of u, in elements, must not be zero
+ * @param max_iterations Maximum number of iterations per problem
+ * @param status Status per problem, IFL_CONTROL_CONVERGED or IFL_CONTROL_MAX_ITERATIONS (count)
+ * @param iterations Iterations per problem (count)
+ * @return 0 on success, -1 on invalid arguments or unsupported dimensions
+ */
+int ifl_control_allocate_batch(size_t m, size_t n, const float *B_row_major, const float *Wv,
+                               size_t count,
+                               const float *v, size_t v_stride,
+                               const float *u_lo, size_t u_lo_stride,
+                               const float *u_up, size_t u_up_stride,
+                               float *u, size_t u_stride,
+                               size_t max_iterations,
+                               int32_t *status, uint32_t *iterations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IFL_CONTROL_C_H
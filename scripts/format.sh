@@ -5,6 +5,8 @@ format=$2
 format_wildcards="""
 ./ifl_control/*.*pp
 ./test/*.*pp
+./bench/*.*pp
+./python/*.*pp
 """
 
 #echo astyle: $astyle
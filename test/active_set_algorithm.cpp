@@ -9,6 +9,11 @@ int test_just_roll();
 int test_ask_too_much_roll();
 int test_ask_some_roll_and_too_much_yaw();
 int test_div_zero();
+int test_sparse_columns();
+int test_shared_configuration();
+int test_collinear_actuators();
+int test_structural_zeros();
+int test_hexacopter_thrust();
 
 bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-4f);
 
@@ -36,6 +41,31 @@ int main()
         return ret;
     }
 
+    ret = test_sparse_columns();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_shared_configuration();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_collinear_actuators();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_structural_zeros();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_hexacopter_thrust();
+    if (ret < 0) {
+        return ret;
+    }
+
     return ret;
 }
 
@@ -155,6 +185,222 @@ int test_div_zero()
     return 0;
 }
 
+int test_sparse_columns()
+{
+    // two rotors and two surfaces, the surfaces only do roll or pitch
+    float B[] = {-20.0f, 20.0f, 10.0f, 0.0f,
+                 17.0f, 17.0f, 0.0f, 10.0f,
+                 0.7f, -0.7f, 0.0f, 0.0f,
+                 -1.2f, -1.2f, 0.0f, 0.0f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float v[] = {30.0f, -10.0f, 0.5f, 0.0f};
+
+    ActiveSetAlgorithm<4,4> dense;
+    dense.setActuatorEffectiveness(B);
+    dense.setOutputWeights(Wv);
+    dense.setActuatorUpperLimit(u_up);
+    dense.setActuatorLowerLimit(u_lo);
+
+    ActiveSetAlgorithm<4,4> sparse;
+    TEST(sparse.setSparseColumns(true) == 0);
+    sparse.setActuatorEffectiveness(B);
+    sparse.setOutputWeights(Wv);
+    sparse.setActuatorUpperLimit(u_up);
+    sparse.setActuatorLowerLimit(u_lo);
+
+    float out_dense[4] = {};
+    float out_sparse[4] = {};
+    dense.calculateActuatorCommands(v, out_dense, 10);
+    sparse.calculateActuatorCommands(v, out_sparse, 10);
+    TEST(isEqual(out_sparse, out_dense, 4));
+
+    // too many rows for a sparsity pattern
+    ActiveSetAlgorithm<33,1> tall;
+    TEST(tall.setSparseColumns(true) < 0);
+    return 0;
+}
+
+int test_shared_configuration()
+{
+    float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                 17.0f, -17.0f, 17.0f, -17.0f,
+                 0.7f, 0.7f, -0.7f, -0.7f,
+                 -1.2f, -1.2f, -1.2f, -1.2f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[3][4] = {{1.0f, 1.0f, 1.0f, 1.0f},
+                        {0.5f, 0.5f, 0.5f, 0.5f},
+                        {1.0f, 0.1f, 1.0f, 1.0f}};
+    float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float v[3][4] = {{20.0f, 0.0f, 0.0f, 0.0f},
+                     {0.0f, 30.0f, 2.0f, -1.0f},
+                     {-10.0f, 10.0f, 5.0f, 0.0f}};
+
+    AllocatorConfiguration<4,4> configuration;
+    configuration.setActuatorEffectiveness(B);
+    configuration.setOutputWeights(Wv);
+    ActiveSetWorkspace<4,4> workspace[3];
+
+    for (size_t n = 0; n < 3; n++) {
+        workspace[n].setActuatorUpperLimit(u_up[n]);
+        workspace[n].setActuatorLowerLimit(u_lo);
+    }
+
+    float out_shared[3][4] = {};
+    for (size_t n = 0; n < 3; n++) {
+        workspace[n].calculateActuatorCommands(configuration, v[n], out_shared[n], 10);
+    }
+
+    // same results as allocators with their own configuration
+    for (size_t n = 0; n < 3; n++) {
+        ActiveSetAlgorithm<4,4> asa;
+        asa.setActuatorEffectiveness(B);
+        asa.setOutputWeights(Wv);
+        asa.setActuatorUpperLimit(u_up[n]);
+        asa.setActuatorLowerLimit(u_lo);
+
+        float out[4] = {};
+        asa.calculateActuatorCommands(v[n], out, 10);
+        TEST(isEqual(out_shared[n], out, 4));
+    }
+
+    // the workspaces do not share state
+    float out[4] = {};
+    workspace[0].calculateActuatorCommands(configuration, v[0], out, 10);
+    TEST(isEqual(out, out_shared[0], 4));
+    return 0;
+}
+
+int test_collinear_actuators()
+{
+    // quadrotor with a second, coaxial motor below the first one
+    float B[] = {-20.0f, 20.0f, 20.0f, -20.0f, -20.0f,
+                 17.0f, -17.0f, 17.0f, -17.0f, 17.0f,
+                 0.7f, 0.7f, -0.7f, -0.7f, 0.7f,
+                 -1.2f, -1.2f, -1.2f, -1.2f, -1.2f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    float v[] = {-3.0f, 2.0f, 0.0f, -2.5f};
+
+    ActiveSetAlgorithm<4,5> asa;
+    asa.setActuatorEffectiveness(B);
+    asa.setOutputWeights(Wv);
+    asa.setActuatorUpperLimit(u_up);
+    asa.setActuatorLowerLimit(u_lo);
+
+    float u[5] = {};
+    asa.calculateActuatorCommands(v, u, 10);
+
+    // the coaxial pair is redundant, the solution is still found
+    float Bu[4] = {};
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            Bu[i] += B[i*5 + j] * u[j];
+        }
+    }
+    TEST(isEqual(Bu, v, 4, 1e-3f));
+    for (size_t j = 0; j < 5; j++) {
+        TEST(u[j] >= u_lo[j] && u[j] <= u_up[j]);
+    }
+    return 0;
+}
+
+int test_structural_zeros()
+{
+    // two rotors and two surfaces, the surfaces only do roll or pitch
+    float B[] = {-20.0f, 20.0f, 10.0f, 0.0f,
+                 17.0f, 17.0f, 0.0f, 10.0f,
+                 0.7f, -0.7f, 0.0f, 0.0f,
+                 -1.2f, -1.2f, 0.0f, 0.0f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float v[] = {30.0f, -10.0f, 0.5f, 0.0f};
+    float x[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float y[] = {0.1f, 0.1f, 0.1f, 0.1f};
+
+    ActiveSetAlgorithm<4,4> dense;
+    dense.setActuatorEffectiveness(B);
+    dense.setOutputWeights(Wv);
+    dense.setActuatorUpperLimit(u_up);
+    dense.setActuatorLowerLimit(u_lo);
+
+    ActiveSetAlgorithm<4,4> sparse;
+    TEST(sparse.setSparseColumns(true) == 0);
+    sparse.setActuatorEffectiveness(B);
+    sparse.setOutputWeights(Wv);
+    sparse.setActuatorUpperLimit(u_up);
+    sparse.setActuatorLowerLimit(u_lo);
+
+    // the zeros of the surfaces are not touched by the update
+    TEST(dense.updateActuatorEffectiveness(x, y) == 0);
+    TEST(sparse.updateActuatorEffectiveness(x, y) == 0);
+    float B_masked[] = {-19.9f, 17.1f, 0.8f, -1.1f,
+                        20.1f, 17.1f, -0.6f, -1.1f,
+                        10.1f, 0.0f, 0.0f, 0.0f,
+                        0.0f, 10.1f, 0.0f, 0.0f};
+    TEST(isEqual(dense.getActuatorEffectiveness(), B_masked, 16));
+    TEST(isEqual(sparse.getActuatorEffectiveness(), B_masked, 16));
+
+    float out_dense[4] = {};
+    float out_sparse[4] = {};
+    dense.calculateActuatorCommands(v, out_dense, 10);
+    sparse.calculateActuatorCommands(v, out_sparse, 10);
+    TEST(isEqual(out_sparse, out_dense, 4));
+
+    // unless fill-in is requested
+    TEST(dense.updateActuatorEffectiveness(x, y, true) == 0);
+    TEST(sparse.updateActuatorEffectiveness(x, y, true) == 0);
+    float B_filled[] = {-19.8f, 17.2f, 0.9f, -1.0f,
+                        20.2f, 17.2f, -0.5f, -1.0f,
+                        10.2f, 0.1f, 0.1f, 0.1f,
+                        0.1f, 10.2f, 0.1f, 0.1f};
+    TEST(isEqual(dense.getActuatorEffectiveness(), B_filled, 16));
+    TEST(isEqual(sparse.getActuatorEffectiveness(), B_filled, 16));
+
+    dense.calculateActuatorCommands(v, out_dense, 10);
+    sparse.calculateActuatorCommands(v, out_sparse, 10);
+    TEST(isEqual(out_sparse, out_dense, 4));
+    return 0;
+}
+
+int test_hexacopter_thrust()
+{
+    // six rotors, two more than outputs
+    float B[] = {-10.0f, -20.0f, -10.0f, 10.0f, 20.0f, 10.0f,
+                 14.7f, 0.0f, -14.7f, -14.7f, 0.0f, 14.7f,
+                 0.7f, -0.7f, 0.7f, -0.7f, 0.7f, -0.7f,
+                 -1.2f, -1.2f, -1.2f, -1.2f, -1.2f, -1.2f
+                };
+    float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+    float u_lo[] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    float v[] = {0.0f, 0.0f, 0.0f, -3.6f};
+
+    // the minimum norm solution spreads thrust evenly over all rotors
+    float expected_out[] = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+
+    for (size_t sparse = 0; sparse < 2; sparse++) {
+        ActiveSetAlgorithm<4,6> asa;
+        TEST(asa.setSparseColumns(sparse == 1) == 0);
+        asa.setActuatorEffectiveness(B);
+        asa.setOutputWeights(Wv);
+        asa.setActuatorUpperLimit(u_up);
+        asa.setActuatorLowerLimit(u_lo);
+
+        float out[6] = {};
+        asa.calculateActuatorCommands(v, out, 10);
+        TEST(isEqual(out, expected_out, 6));
+    }
+    return 0;
+}
+
 bool isEqual(const float actual[], const float expected[], size_t len, float eps)
 {
     bool equal = true;
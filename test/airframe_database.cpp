@@ -0,0 +1,367 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/AirframeDatabase.hpp"
+#include "ifl_control/MappedFile.hpp"
+
+#include <cstring>
+
+using namespace ifl_control;
+
+int test_build_and_find();
+int test_decomposition();
+int test_attach_allocator();
+int test_failure_mode();
+int test_mapped_file();
+int test_invalid_database();
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-4f);
+size_t buildDatabase();
+
+static const float B_quad[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                               17.0f, -17.0f, 17.0f, -17.0f,
+                               0.7f, 0.7f, -0.7f, -0.7f,
+                               -1.2f, -1.2f, -1.2f, -1.2f
+                              };
+static const float Wv_quad[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+static const float u_up_quad[] = {1.0f, 1.0f, 1.0f, 1.0f};
+static const float u_lo_quad[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+
+// roll and pitch with three surfaces
+static const float B_wing[] = {1.0f, -1.0f, 0.5f,
+                               0.0f, 0.5f, 2.0f
+                              };
+static const float Wv_wing[] = {1.0f, 2.0f};
+static const float u_up_wing[] = {0.5f, 0.5f, 0.5f};
+static const float u_lo_wing[] = {-0.5f, -0.5f, -0.5f};
+
+alignas(64) static uint8_t database[16384];
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_build_and_find();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_decomposition();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_attach_allocator();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_failure_mode();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_mapped_file();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_invalid_database();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+size_t buildDatabase()
+{
+    memset(database, 0, sizeof(database));
+    AirframeDatabaseWriter writer(database, sizeof(database), 4);
+
+    // single motor failures of the quadrotor
+    uint32_t failures_quad[] = {0x1, 0x2};
+    if (writer.addAirframe<4,4>(4001, B_quad, Wv_quad, u_lo_quad, u_up_quad, failures_quad, 2) < 0) {
+        return 0;
+    }
+    uint32_t failures_wing[] = {0x4};
+    if (writer.addAirframe<2,3>(2100, B_wing, Wv_wing, u_lo_wing, u_up_wing, failures_wing, 1) < 0) {
+        return 0;
+    }
+    return writer.finalize();
+}
+
+int test_build_and_find()
+{
+    size_t size = buildDatabase();
+    TEST(size > 0);
+
+    AirframeDatabase db;
+    TEST(db.attach(database, size) == 0);
+    TEST(db.getAirframeCount() == 2);
+
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+    TEST(quad.getConfigurationCount() == 3);
+    TEST(quad.getFailedActuators(0) == 0);
+    TEST(quad.getFailedActuators(2) == 0x2);
+    TEST(isEqual(quad.getOutputWeights(), Wv_quad, 4));
+    TEST(isEqual(quad.getActuatorUpperLimit(0), u_up_quad, 4));
+
+    // column major
+    float B_expected[16];
+    for (size_t l = 0; l < 16; l++) {
+        B_expected[l] = B_quad[(l%4)*4 + l/4];
+    }
+    TEST(isEqual(quad.getActuatorEffectiveness(0), B_expected, 16));
+
+    // all sections are aligned
+    TEST(reinterpret_cast<uintptr_t>(quad.getWeightedEffectiveness(1)) % AirframeLayout::ALIGNMENT == 0);
+    TEST(reinterpret_cast<uintptr_t>(quad.getDecompositionPermutation(2)) % AirframeLayout::ALIGNMENT == 0);
+
+    // wrong dimensions or unknown airframe
+    AirframeRecord<4,6> hex;
+    TEST(db.find(4001, hex) < 0);
+    TEST(db.find(1234, quad) < 0);
+    return 0;
+}
+
+int test_decomposition()
+{
+    size_t size = buildDatabase();
+    AirframeDatabase db;
+    TEST(db.attach(database, size) == 0);
+
+    // the stored decomposition is the one the allocator would compute
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+    for (size_t configuration = 0; configuration < 3; configuration++) {
+        float QR[16];
+        float tau[8];
+        float w[4];
+        size_t perm[4];
+        uint32_t pattern[4];
+        for (size_t l = 0; l < 16; l++) {
+            QR[l] = quad.getWeightedEffectiveness(configuration)[l];
+        }
+        for (size_t j = 0; j < 4; j++) {
+            pattern[j] = quad.getSparsityPattern(configuration)[j];
+        }
+        LeastSquaresSolver solver;
+        TEST(solver.setMatrixPivoted(QR, tau, w, perm, 4, 4, pattern) == 0);
+        TEST(quad.getDecompositionRank(configuration) == solver.getRank());
+        TEST(isEqual(quad.getDecomposition(configuration), QR, 16, 0.0f));
+        // a second set of reflections only when rank deficient
+        const size_t taus = solver.getRank() < 4 ? 2 * solver.getRank() : 4;
+        TEST(isEqual(quad.getDecompositionTau(configuration), tau, taus, 0.0f));
+        for (size_t j = 0; j < 4; j++) {
+            TEST(quad.getDecompositionPermutation(configuration)[j] == perm[j]);
+            TEST(quad.getDecompositionPattern(configuration)[j] == pattern[j]);
+        }
+    }
+
+    // a failed motor is moved behind the rank
+    TEST(quad.getDecompositionRank(0) == 4);
+    TEST(quad.getDecompositionRank(1) == 3);
+    TEST(quad.getDecompositionPermutation(1)[3] == 0);
+
+    // more actuators than outputs, the failed surface is not used
+    AirframeRecord<2,3> wing;
+    TEST(db.find(2100, wing) == 0);
+    TEST(wing.getDecompositionRank(0) == 2);
+    TEST(wing.getDecompositionRank(1) == 2);
+    TEST(wing.getDecompositionPermutation(1)[2] == 2);
+    return 0;
+}
+
+int test_attach_allocator()
+{
+    size_t size = buildDatabase();
+    AirframeDatabase db;
+    TEST(db.attach(database, size) == 0);
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+
+    ActiveSetAlgorithm<4,4> attached;
+    TEST(quad.attach(attached, 0) == 0);
+    TEST(attached.isAttached());
+    TEST(attached.getActuatorEffectiveness() == quad.getActuatorEffectiveness(0));
+
+    ActiveSetAlgorithm<4,4> copied;
+    copied.setActuatorEffectiveness(B_quad);
+    copied.setOutputWeights(Wv_quad);
+    copied.setActuatorUpperLimit(u_up_quad);
+    copied.setActuatorLowerLimit(u_lo_quad);
+
+    float v[] = {20.0f, 0.0f, 5.0f, 0.0f};
+    float out_attached[4] = {};
+    float out_copied[4] = {};
+    attached.calculateActuatorCommands(v, out_attached, 10);
+    copied.calculateActuatorCommands(v, out_copied, 10);
+    TEST(isEqual(out_attached, out_copied, 4));
+
+    // modifying detaches, the database is untouched
+    float Wv[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    attached.setOutputWeights(Wv);
+    TEST(!attached.isAttached());
+    TEST(isEqual(quad.getOutputWeights(), Wv_quad, 4));
+    return 0;
+}
+
+int test_failure_mode()
+{
+    size_t size = buildDatabase();
+    AirframeDatabase db;
+    TEST(db.attach(database, size) == 0);
+    AirframeRecord<2,3> wing;
+    TEST(db.find(2100, wing) == 0);
+
+    ActiveSetAlgorithm<2,3> asa;
+    TEST(wing.attach(asa, 1) == 0);
+    TEST(wing.attach(asa, 2) < 0);
+
+    // the failed surface has no effect in the effectiveness, and is pinned
+    const float *B = asa.getActuatorEffectiveness();
+    TEST(fabs(B[2*2]) < 1e-8f && fabs(B[2*2 + 1]) < 1e-8f);
+    TEST(fabs(wing.getActuatorLowerLimit(1)[2]) < 1e-8f && fabs(wing.getActuatorUpperLimit(1)[2]) < 1e-8f);
+    TEST(isEqual(wing.getActuatorUpperLimit(1), u_up_wing, 2));
+
+    // the remaining surfaces give roll and pitch
+    float v[] = {0.2f, 0.1f};
+    float u[3] = {0.1f, 0.1f, 0.1f};
+    asa.calculateActuatorCommands(v, u, 10);
+    float expected_u[] = {0.4f, 0.2f, 0.0f};
+    TEST(isEqual(u, expected_u, 3));
+
+    // a quadrotor with a failed motor still controls roll and pitch
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+    ActiveSetAlgorithm<4,4> attached;
+    TEST(quad.attach(attached, 1) == 0);
+
+    float B_failed[16];
+    for (size_t l = 0; l < 16; l++) {
+        B_failed[l] = l % 4 == 0 ? 0.0f : B_quad[l];
+    }
+    ActiveSetAlgorithm<4,4> copied;
+    copied.setActuatorEffectiveness(B_failed);
+    copied.setOutputWeights(Wv_quad);
+    copied.setActuatorLowerLimit(quad.getActuatorLowerLimit(1));
+    copied.setActuatorUpperLimit(quad.getActuatorUpperLimit(1));
+
+    float v_quad[] = {5.0f, -5.0f, 0.0f, -1.0f};
+    float out_attached[4] = {};
+    float out_copied[4] = {};
+    attached.calculateActuatorCommands(v_quad, out_attached, 10);
+    copied.calculateActuatorCommands(v_quad, out_copied, 10);
+    TEST(isEqual(out_attached, out_copied, 4));
+    TEST(fabs(out_attached[0]) < 1e-8f);
+    for (size_t j = 0; j < 4; j++) {
+        TEST(isfinite(out_attached[j]));
+    }
+    return 0;
+}
+
+int test_mapped_file()
+{
+    size_t size = buildDatabase();
+    const char *path = "airframe_database_test.bin";
+    FILE *file = fopen(path, "wb");
+    TEST(file != nullptr);
+    TEST(fwrite(database, 1, size, file) == size);
+    fclose(file);
+
+    MappedFile mapped;
+    TEST(mapped.open(path) == 0);
+    TEST(mapped.size() == size);
+
+    AirframeDatabase db;
+    TEST(db.attach(mapped.data(), mapped.size()) == 0);
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+    TEST(isEqual(quad.getOutputWeights(), Wv_quad, 4));
+
+    mapped.close();
+    remove(path);
+
+    MappedFile missing;
+    TEST(missing.open("does_not_exist.bin") < 0);
+    return 0;
+}
+
+int test_invalid_database()
+{
+    size_t size = buildDatabase();
+    AirframeDatabase db;
+
+    // truncated
+    TEST(db.attach(database, size - 1) < 0);
+    TEST(db.getAirframeCount() == 0);
+
+    // misaligned
+    TEST(db.attach(database + 4, size - 4) < 0);
+
+    // other version
+    AirframeDatabaseHeader *header = reinterpret_cast<AirframeDatabaseHeader *>(database);
+    header->version = AirframeDatabase::VERSION + 1;
+    TEST(db.attach(database, size) < 0);
+
+    // written with another word size
+    header->version = AirframeDatabase::VERSION;
+    TEST(db.attach(database, size) == 0);
+    header->word_size = 2 * sizeof(size_t);
+    TEST(db.attach(database, size) < 0);
+
+    // damaged permutation of a decomposition
+    size = buildDatabase();
+    TEST(db.attach(database, size) == 0);
+    AirframeRecord<4,4> quad;
+    TEST(db.find(4001, quad) == 0);
+    size_t *perm = const_cast<size_t *>(quad.getDecompositionPermutation(1));
+    const size_t original = perm[2];
+    perm[2] = 1000000;
+    TEST(db.attach(database, size) < 0);
+    ActiveSetAlgorithm<4,4> asa;
+    TEST(quad.attach(asa, 1) < 0);
+    AllocatorConfiguration<4,4> shared;
+    TEST(quad.attach(shared, 1) < 0);
+
+    // column used twice
+    perm[2] = perm[0];
+    TEST(db.attach(database, size) < 0);
+    TEST(quad.attach(asa, 1) < 0);
+    perm[2] = original;
+    TEST(db.attach(database, size) == 0);
+    TEST(quad.attach(asa, 1) == 0);
+
+    // rank above min(M, N)
+    AirframeLayout layout(4, 4, quad.getConfigurationCount());
+    const uint8_t *configuration = reinterpret_cast<const uint8_t *>(quad.getActuatorLowerLimit(1)) - layout.u_lo;
+    uint32_t *rank = const_cast<uint32_t *>(reinterpret_cast<const uint32_t *>(configuration + layout.rank));
+    TEST(*rank == quad.getDecompositionRank(1));
+    *rank = 5;
+    TEST(db.attach(database, size) < 0);
+    TEST(quad.attach(asa, 1) < 0);
+    return 0;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
@@ -0,0 +1,151 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/BiquadFilterBank.hpp"
+
+using namespace ifl_control;
+
+int test_pass_through();
+int test_channels_identical();
+int test_step_response();
+int test_reset();
+int test_invalid_cutoff();
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-5f);
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_pass_through();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_channels_identical();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_step_response();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_reset();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_invalid_cutoff();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int test_pass_through()
+{
+    BiquadFilterBank<3, 2> bank;
+    float x[3] = {1.0f, -2.0f, 3.0f};
+    float y[3] = {};
+    bank.update(x, y);
+    TEST(isEqual(y, x, 3));
+    return 0;
+}
+
+int test_channels_identical()
+{
+    // every channel of the bank behaves as a separate single channel filter
+    BiquadFilterBank<5, 2> bank;
+    BiquadFilterBank<1, 2> single[5];
+    TEST(bank.setLowPass(4000.0f, 50.0f) == 0);
+    for (size_t c = 0; c < 5; c++) {
+        TEST(single[c].setLowPass(4000.0f, 50.0f) == 0);
+    }
+
+    for (size_t k = 0; k < 200; k++) {
+        float x[5];
+        float y[5];
+        float y_single[5];
+        for (size_t c = 0; c < 5; c++) {
+            x[c] = sin(0.01f * static_cast<float>(k * (c + 1))) + static_cast<float>(c);
+            single[c].update(&x[c], &y_single[c]);
+        }
+        bank.update(x, y);
+        TEST(isEqual(y, y_single, 5));
+    }
+    return 0;
+}
+
+int test_step_response()
+{
+    BiquadFilterBank<2, 1> bank;
+    TEST(bank.setLowPass(1000.0f, 100.0f) == 0);
+
+    float x[2] = {1.0f, -1.0f};
+    float y[2] = {};
+    bank.update(x, y);
+
+    // the first output is b0 of the second order Butterworth filter
+    const float K = tan(3.14159265f * 0.1f);
+    const float b0 = K * K / (1.0f + sqrt(2.0f) * K + K * K);
+    float expected_first[2] = {b0, -b0};
+    TEST(isEqual(y, expected_first, 2));
+
+    // unity gain at DC
+    for (size_t k = 0; k < 1000; k++) {
+        bank.update(x, y);
+    }
+    TEST(isEqual(y, x, 2, 1e-4f));
+    return 0;
+}
+
+int test_reset()
+{
+    BiquadFilterBank<3, 2> bank;
+    TEST(bank.setLowPass(4000.0f, 30.0f) == 0);
+
+    float x[3] = {0.5f, 2.0f, -4.0f};
+    float y[3] = {};
+    bank.reset(x);
+
+    // the output stays at the steady state
+    for (size_t k = 0; k < 10; k++) {
+        bank.update(x, y);
+        TEST(isEqual(y, x, 3, 1e-3f));
+    }
+    TEST(isEqual(bank.getOutput(), x, 3, 1e-3f));
+    return 0;
+}
+
+int test_invalid_cutoff()
+{
+    BiquadFilterBank<1> bank;
+    TEST(bank.setLowPass(1000.0f, 0.0f) < 0);
+    TEST(bank.setLowPass(1000.0f, 500.0f) < 0);
+    TEST(bank.setSection(1, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f) < 0);
+    return 0;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
@@ -0,0 +1,167 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/ActiveSetAlgorithm.hpp"
+#include "ifl_control_c.h"
+
+using namespace ifl_control;
+
+int test_batch();
+int test_shared_bounds();
+int test_invalid_arguments();
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-6f);
+
+static const float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                          17.0f, -17.0f, 17.0f, -17.0f,
+                          0.7f, 0.7f, -0.7f, -0.7f,
+                          -1.2f, -1.2f, -1.2f, -1.2f
+                         };
+static const float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_batch();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_shared_bounds();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_invalid_arguments();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int test_batch()
+{
+    const size_t count = 3;
+    float v[count][4] = {{20.0f, 0.0f, 0.0f, 0.0f},
+                         {0.0f, 30.0f, 2.0f, -1.0f},
+                         {-10.0f, 10.0f, 5.0f, 0.0f}};
+    float u_lo[count][4] = {{-1.0f, -1.0f, -1.0f, -1.0f},
+                            {-1.0f, -1.0f, -1.0f, -1.0f},
+                            {0.0f, 0.0f, 0.0f, 0.0f}};
+    float u_up[count][4] = {{1.0f, 1.0f, 1.0f, 1.0f},
+                            {0.5f, 0.5f, 0.5f, 0.5f},
+                            {1.0f, 1.0f, 1.0f, 1.0f}};
+    float u[count][4] = {};
+    int32_t status[count] = {};
+    uint32_t iterations[count] = {};
+
+    TEST(ifl_control_allocate_batch(4, 4, B, Wv, count, v[0], 4, u_lo[0], 4, u_up[0], 4, u[0], 4, 10,
+                                    status, iterations) == 0);
+
+    // same as the allocator itself
+    for (size_t k = 0; k < count; k++) {
+        ActiveSetAlgorithm<4,4> asa;
+        asa.setActuatorEffectiveness(B);
+        asa.setOutputWeights(Wv);
+        asa.setActuatorLowerLimit(u_lo[k]);
+        asa.setActuatorUpperLimit(u_up[k]);
+
+        float u_check[4] = {};
+        asa.calculateActuatorCommands(v[k], u_check, 10);
+        TEST(isEqual(u[k], u_check, 4));
+        TEST(iterations[k] == asa.getIterationCount());
+        TEST(status[k] == (asa.hasConverged() ? IFL_CONTROL_CONVERGED : IFL_CONTROL_MAX_ITERATIONS));
+    }
+
+    // out of iterations
+    float u_limited[count][4] = {};
+    TEST(ifl_control_allocate_batch(4, 4, B, Wv, count, v[0], 4, u_lo[0], 4, u_up[0], 4, u_limited[0], 4, 1,
+                                    status, iterations) == 0);
+    TEST(iterations[1] == 1);
+    TEST(status[1] == IFL_CONTROL_MAX_ITERATIONS);
+    return 0;
+}
+
+int test_shared_bounds()
+{
+    const size_t count = 2;
+    float v[count][4] = {{20.0f, 0.0f, 0.0f, 0.0f},
+                         {0.0f, 0.0f, 0.0f, -2.0f}};
+    float u_lo[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float u[count][4] = {};
+    int32_t status[count] = {};
+    uint32_t iterations[count] = {};
+
+    TEST(ifl_control_allocate_batch(4, 4, B, Wv, count, v[0], 4, u_lo, 0, u_up, 0, u[0], 4, 10,
+                                    status, iterations) == 0);
+
+    // pure thrust, all motors equal
+    for (size_t j = 1; j < 4; j++) {
+        TEST(fabs(u[1][j] - u[1][0]) < 1e-5f);
+    }
+    TEST(u[1][0] > 0.0f);
+    return 0;
+}
+
+int test_invalid_arguments()
+{
+    float v[6] = {};
+    float u_lo[16] = {};
+    float u_up[16] = {};
+    float u[16] = {};
+    int32_t status[1] = {};
+    uint32_t iterations[1] = {};
+    float B_large[7*17] = {};
+    float Wv_large[7] = {};
+
+    TEST(ifl_control_allocate_batch(7, 4, B_large, Wv_large, 1, v, 0, u_lo, 0, u_up, 0, u, 4, 10,
+                                    status, iterations) < 0);
+    TEST(ifl_control_allocate_batch(4, 17, B_large, Wv_large, 1, v, 0, u_lo, 0, u_up, 0, u, 4, 10,
+                                    status, iterations) < 0);
+    TEST(ifl_control_allocate_batch(4, 4, nullptr, Wv, 1, v, 0, u_lo, 0, u_up, 0, u, 4, 10,
+                                    status, iterations) < 0);
+
+    // the output rows must not overlap
+    TEST(ifl_control_allocate_batch(4, 4, B, Wv, 2, v, 0, u_lo, 0, u_up, 0, u, 0, 10,
+                                    status, iterations) < 0);
+
+    // a different size than 4 by 4
+    float B_wing[] = {1.0f, -1.0f, 0.5f,
+                      0.0f, 0.5f, 2.0f
+                     };
+    float Wv_wing[] = {1.0f, 1.0f};
+    float v_wing[] = {0.5f, 1.0f};
+    float lo_wing[] = {-1.0f, -1.0f, -1.0f};
+    float up_wing[] = {1.0f, 1.0f, 1.0f};
+    float u_wing[3] = {};
+    TEST(ifl_control_allocate_batch(2, 3, B_wing, Wv_wing, 1, v_wing, 0, lo_wing, 0, up_wing, 0, u_wing, 3, 10,
+                                    status, iterations) == 0);
+    TEST(status[0] == IFL_CONTROL_CONVERGED);
+    TEST(fabs(u_wing[0] - u_wing[1] + 0.5f * u_wing[2] - 0.5f) < 1e-5f);
+    TEST(fabs(0.5f * u_wing[1] + 2.0f * u_wing[2] - 1.0f) < 1e-5f);
+    return 0;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
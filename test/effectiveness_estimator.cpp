@@ -0,0 +1,160 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/EffectivenessEstimator.hpp"
+
+using namespace ifl_control;
+
+int test_converge();
+int converge(float lambda);
+int test_low_excitation();
+int test_invalid_parameters();
+
+void to_column_major(const float data_row_major[], size_t rows, size_t columns, float data[]);
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-4f);
+
+static const float B_true[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                               17.0f, -17.0f, 17.0f, -17.0f,
+                               0.7f, 0.7f, -0.7f, -0.7f,
+                               -1.2f, -1.2f, -1.2f, -1.2f
+                              };
+static const float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+static const float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+static const float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_converge();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_low_excitation();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_invalid_parameters();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int test_converge()
+{
+    // the smoothed excitation power keeps the step size independent of lambda
+    const float lambdas[] = {0.0f, 0.5f, 0.99f};
+    for (float lambda : lambdas) {
+        TEST(converge(lambda) == 0);
+    }
+    return 0;
+}
+
+int converge(float lambda)
+{
+    // start with a loss of half the effectiveness
+    float B_initial[16];
+    for (size_t l = 0; l < 16; l++) {
+        B_initial[l] = 0.5f * B_true[l];
+    }
+
+    ActiveSetAlgorithm<4,4> asa;
+    asa.setActuatorEffectiveness(B_initial);
+    asa.setOutputWeights(Wv);
+    asa.setActuatorUpperLimit(u_up);
+    asa.setActuatorLowerLimit(u_lo);
+
+    EffectivenessEstimator<4,4> estimator;
+    float mu[] = {0.5f, 0.5f, 0.5f, 0.5f};
+    TEST(estimator.setLearningRate(mu) == 0);
+    TEST(estimator.setForgettingFactor(lambda) == 0);
+
+    for (size_t k = 0; k < 2000; k++) {
+        float du[4];
+        float dw[4] = {};
+        for (size_t j = 0; j < 4; j++) {
+            du[j] = 0.01f * sin(0.7f * static_cast<float>(k * (j + 1)) + static_cast<float>(j));
+        }
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) {
+                dw[i] += B_true[i*4 + j] * du[j];
+            }
+        }
+        estimator.update(du, dw, asa);
+    }
+
+    float B_expected[16];
+    to_column_major(B_true, 4, 4, B_expected);
+    TEST(isEqual(asa.getActuatorEffectiveness(), B_expected, 16, 1e-2f));
+
+    // the allocator now behaves as with the true effectiveness
+    float v[] = {10.0f, 0.0f, 0.0f, 0.0f};
+    float out[4] = {};
+    asa.calculateActuatorCommands(v, out, 10);
+    float expected_out[4] = {-0.125f, 0.125f, 0.125f, -0.125f};
+    TEST(isEqual(out, expected_out, 4, 1e-3f));
+    return 0;
+}
+
+int test_low_excitation()
+{
+    ActiveSetAlgorithm<4,4> asa;
+    asa.setActuatorEffectiveness(B_true);
+    asa.setOutputWeights(Wv);
+
+    EffectivenessEstimator<4,4> estimator;
+    float mu[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    estimator.setLearningRate(mu);
+    TEST(estimator.setMinimumExcitation(1e-4f) == 0);
+
+    float du[] = {0.001f, 0.0f, 0.0f, 0.0f};
+    float dw[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    TEST(estimator.update(du, dw, asa) == 1);
+
+    float B_expected[16];
+    to_column_major(B_true, 4, 4, B_expected);
+    TEST(isEqual(asa.getActuatorEffectiveness(), B_expected, 16));
+    return 0;
+}
+
+int test_invalid_parameters()
+{
+    EffectivenessEstimator<2,2> estimator;
+    float mu[] = {0.5f, -0.1f};
+    TEST(estimator.setLearningRate(mu) < 0);
+    TEST(estimator.setForgettingFactor(1.0f) < 0);
+    TEST(estimator.setMinimumExcitation(-1.0f) < 0);
+    return 0;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
+
+void to_column_major(const float data_row_major[], size_t rows, size_t columns, float data[])
+{
+    for (size_t i = 0; i < rows*columns; i++) {
+        data[i] = data_row_major[(i%rows)*columns + (i/rows)];
+    }
+}
@@ -0,0 +1,435 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/HorizonAllocator.hpp"
+#include "ifl_control/ActiveSetAlgorithm.hpp"
+
+using namespace ifl_control;
+
+int test_single_sample();
+int test_rate_limited_roll();
+int test_anticipate_step();
+int test_redundant_actuators();
+int test_invalid_parameters();
+int test_free_rate_chain();
+int test_brute_force();
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-4f);
+bool isFeasible(const float u[], const float u_prev[], size_t n, size_t h, float lo, float up, float rate);
+double horizonCost(const float u[], const float v[], float u_prev, size_t h, float w2);
+double bruteForceHorizon(const float v[], float u_prev, size_t h, float lo, float up, float rate, float w2);
+
+static const float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                          17.0f, -17.0f, 17.0f, -17.0f,
+                          0.7f, 0.7f, -0.7f, -0.7f,
+                          -1.2f, -1.2f, -1.2f, -1.2f
+                         };
+static const float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+static const float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+static const float u_lo[] = {-1.0f, -1.0f, -1.0f, -1.0f};
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_single_sample();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_rate_limited_roll();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_anticipate_step();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_redundant_actuators();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_invalid_parameters();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_free_rate_chain();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_brute_force();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int test_single_sample()
+{
+    // without rate limits, a horizon of one is the single sample allocation
+    float Wr[] = {1e-3f, 1e-3f, 1e-3f, 1e-3f};
+
+    HorizonAllocator<4,4,1> horizon;
+    horizon.setActuatorEffectiveness(B);
+    horizon.setOutputWeights(Wv);
+    horizon.setActuatorUpperLimit(u_up);
+    horizon.setActuatorLowerLimit(u_lo);
+    TEST(horizon.setRateWeights(Wr) == 0);
+
+    ActiveSetAlgorithm<4,4> asa;
+    asa.setActuatorEffectiveness(B);
+    asa.setOutputWeights(Wv);
+    asa.setActuatorUpperLimit(u_up);
+    asa.setActuatorLowerLimit(u_lo);
+
+    float v[] = {20.0f, 0.0f, 5.0f, 0.0f};
+    float u_prev[4] = {};
+    float out[4] = {};
+    float expected_out[4] = {};
+    TEST(horizon.calculateActuatorCommands(v, u_prev, out, 10) == 0);
+    asa.calculateActuatorCommands(v, expected_out, 10);
+    TEST(isEqual(out, expected_out, 4, 1e-3f));
+    return 0;
+}
+
+int test_rate_limited_roll()
+{
+    float rate[] = {0.3f, 0.3f, 0.3f, 0.3f};
+    float Wr[] = {1e-3f, 1e-3f, 1e-3f, 1e-3f};
+
+    HorizonAllocator<4,4,5> horizon;
+    horizon.setActuatorEffectiveness(B);
+    horizon.setOutputWeights(Wv);
+    horizon.setActuatorUpperLimit(u_up);
+    horizon.setActuatorLowerLimit(u_lo);
+    TEST(horizon.setActuatorRateLimit(rate) == 0);
+    horizon.setRateWeights(Wr);
+
+    // 100 is too much, can only do 80 (4x20), and only 0.3 per sample
+    float v[5*4] = {};
+    for (size_t t = 0; t < 5; t++) {
+        v[t*4] = 100.0f;
+    }
+    float u_prev[4] = {};
+    float u[5*4] = {};
+    TEST(horizon.calculateActuatorCommands(v, u_prev, u, 50) == 0);
+
+    float expected_u[5*4] = {-0.3f, 0.3f, 0.3f, -0.3f,
+                             -0.6f, 0.6f, 0.6f, -0.6f,
+                             -0.9f, 0.9f, 0.9f, -0.9f,
+                             -1.0f, 1.0f, 1.0f, -1.0f,
+                             -1.0f, 1.0f, 1.0f, -1.0f
+                            };
+    TEST(isEqual(u, expected_u, 5*4, 1e-3f));
+    TEST(isFeasible(u, u_prev, 4, 5, -1.0f, 1.0f, 0.3f));
+    return 0;
+}
+
+int test_anticipate_step()
+{
+    float B1[] = {1.0f};
+    float Wv1[] = {1.0f};
+    float up[] = {1.0f};
+    float lo[] = {-1.0f};
+    float rate[] = {0.2f};
+    float Wr[] = {0.1f};
+
+    HorizonAllocator<1,1,6> horizon;
+    horizon.setActuatorEffectiveness(B1);
+    horizon.setOutputWeights(Wv1);
+    horizon.setActuatorUpperLimit(up);
+    horizon.setActuatorLowerLimit(lo);
+    horizon.setActuatorRateLimit(rate);
+    horizon.setRateWeights(Wr);
+
+    // a step three samples ahead
+    float v[6] = {0.0f, 0.0f, 0.0f, 0.8f, 0.8f, 0.8f};
+    float u_prev[1] = {};
+    float u[6] = {};
+    TEST(horizon.calculateActuatorCommands(v, u_prev, u, 50) == 0);
+    TEST(isFeasible(u, u_prev, 1, 6, -1.0f, 1.0f, 0.2f));
+
+    // the actuator starts moving before the step
+    TEST(u[1] > 0.05f);
+
+    // and gets further at the step than sample by sample allocation (0.2)
+    TEST(u[3] > 0.45f);
+    return 0;
+}
+
+int test_redundant_actuators()
+{
+    // more actuators than outputs, the rate weights split the command evenly
+    float B2[] = {1.0f, 1.0f};
+    float Wv1[] = {1.0f};
+    float up[] = {1.0f, 1.0f};
+    float lo[] = {-1.0f, -1.0f};
+    float Wr[] = {0.01f, 0.01f};
+
+    HorizonAllocator<1,2,3> horizon;
+    horizon.setActuatorEffectiveness(B2);
+    horizon.setOutputWeights(Wv1);
+    horizon.setActuatorUpperLimit(up);
+    horizon.setActuatorLowerLimit(lo);
+    horizon.setRateWeights(Wr);
+
+    float v[3] = {1.0f, 1.0f, 1.0f};
+    float u_prev[2] = {};
+    float u[3*2] = {};
+    TEST(horizon.calculateActuatorCommands(v, u_prev, u, 10) == 0);
+    float expected_u[3*2] = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+    TEST(isEqual(u, expected_u, 3*2, 1e-3f));
+    return 0;
+}
+
+int test_invalid_parameters()
+{
+    HorizonAllocator<2,2,3> horizon;
+    float rate[] = {0.1f, -0.1f};
+    float Wr[] = {1.0f, 0.0f};
+    TEST(horizon.setActuatorRateLimit(rate) < 0);
+    TEST(horizon.setRateWeights(Wr) < 0);
+    return 0;
+}
+
+int test_free_rate_chain()
+{
+    // the rate limits between the last samples form a chain without a bound
+    // or a tie to the last applied command, they have to be released
+    float B1[] = {1.0f};
+    float Wv1[] = {1.0f};
+    float up[] = {1.0f};
+    float lo[] = {-1.0f};
+    float rate[] = {0.11f};
+    float Wr[] = {0.46f};
+
+    HorizonAllocator<1,1,5> horizon;
+    horizon.setActuatorEffectiveness(B1);
+    horizon.setOutputWeights(Wv1);
+    horizon.setActuatorUpperLimit(up);
+    horizon.setActuatorLowerLimit(lo);
+    horizon.setActuatorRateLimit(rate);
+    horizon.setRateWeights(Wr);
+
+    float v[5] = {-0.16f, 2.76f, 0.42f, 0.36f, 0.07f};
+    float u_prev[1] = {};
+    float u[5] = {};
+    TEST(horizon.calculateActuatorCommands(v, u_prev, u, 100) == 0);
+    TEST(isFeasible(u, u_prev, 1, 5, -1.0f, 1.0f, 0.11f));
+
+    float expected_u[5] = {0.11f, 0.22f, 0.33f, 0.2757f, 0.1657f};
+    TEST(isEqual(u, expected_u, 5, 1e-3f));
+    return 0;
+}
+
+int test_brute_force()
+{
+    // compare with the optimum over all active sets, for random 1x1 problems
+    const size_t h = 4;
+    float B1[] = {1.0f};
+    float Wv1[] = {1.0f};
+    float up[] = {1.0f};
+    float lo[] = {-1.0f};
+
+    uint32_t seed = 12345;
+    for (size_t k = 0; k < 30; k++) {
+        float values[h + 3];
+        for (size_t l = 0; l < h + 3; l++) {
+            seed = seed * 1664525u + 1013904223u;
+            values[l] = static_cast<float>(seed >> 8) / 16777216.0f;
+        }
+        float v[h];
+        for (size_t t = 0; t < h; t++) {
+            v[t] = 3.0f * values[t] - 1.5f;
+        }
+        float rate[] = {0.05f + 0.4f * values[h]};
+        float Wr[] = {0.1f + values[h + 1]};
+        float u_prev[] = {values[h + 2] - 0.5f};
+
+        HorizonAllocator<1,1,h> horizon;
+        horizon.setActuatorEffectiveness(B1);
+        horizon.setOutputWeights(Wv1);
+        horizon.setActuatorUpperLimit(up);
+        horizon.setActuatorLowerLimit(lo);
+        horizon.setActuatorRateLimit(rate);
+        horizon.setRateWeights(Wr);
+
+        float u[h] = {};
+        TEST(horizon.calculateActuatorCommands(v, u_prev, u, 100) == 0);
+        TEST(isFeasible(u, u_prev, 1, h, -1.0f, 1.0f, rate[0]));
+
+        const double optimum = bruteForceHorizon(v, u_prev[0], h, -1.0f, 1.0f, rate[0], Wr[0] * Wr[0]);
+        TEST(horizonCost(u, v, u_prev[0], h, Wr[0] * Wr[0]) < optimum + 1e-4);
+    }
+    return 0;
+}
+
+double horizonCost(const float u[], const float v[], float u_prev, size_t h, float w2)
+{
+    double cost = 0.0;
+    for (size_t t = 0; t < h; t++) {
+        const double e = static_cast<double>(u[t]) - v[t];
+        const double du = static_cast<double>(u[t]) - (t == 0 ? u_prev : u[t-1]);
+        cost += e * e + w2 * du * du;
+    }
+    return cost;
+}
+
+/**
+ * Minimum cost of a 1x1 problem with unit effectiveness and weight, by solving
+ * the equality constrained problem of every combination of active bounds and
+ * rate limits.
+ */
+double bruteForceHorizon(const float v[], float u_prev, size_t h, float lo, float up, float rate, float w2)
+{
+    const size_t max_size = 3*8;
+    double best = 1e30;
+
+    size_t combinations = 1;
+    for (size_t t = 0; t < h; t++) {
+        combinations *= 9;
+    }
+
+    for (size_t code = 0; code < combinations; code++) {
+        // KKT system [P C^T; C 0] [u; lambda] = [-q; d], for 0.5 u^T P u + q^T u
+        double K[max_size*max_size] = {};
+        double rhs[max_size] = {};
+        size_t n = h;
+        for (size_t t = 0; t < h; t++) {
+            K[t*max_size + t] = 2.0 * (1.0 + w2 * (t + 1 < h ? 2.0 : 1.0));
+            if (t + 1 < h) {
+                K[t*max_size + t + 1] = -2.0 * w2;
+                K[(t + 1)*max_size + t] = -2.0 * w2;
+            }
+            rhs[t] = 2.0 * v[t] + (t == 0 ? 2.0 * w2 * u_prev : 0.0);
+        }
+
+        size_t c = code;
+        for (size_t t = 0; t < h; t++) {
+            const size_t box = c % 3;
+            const size_t rate_state = (c / 3) % 3;
+            c /= 9;
+            if (box != 0) {
+                K[n*max_size + t] = 1.0;
+                K[t*max_size + n] = 1.0;
+                rhs[n] = box == 1 ? lo : up;
+                n++;
+            }
+            if (rate_state != 0) {
+                const double step = rate_state == 1 ? rate : -rate;
+                K[n*max_size + t] = 1.0;
+                K[t*max_size + n] = 1.0;
+                if (t > 0) {
+                    K[n*max_size + t - 1] = -1.0;
+                    K[(t - 1)*max_size + n] = -1.0;
+                    rhs[n] = step;
+                } else {
+                    rhs[n] = u_prev + step;
+                }
+                n++;
+            }
+        }
+
+        // gaussian elimination with partial pivoting, skip dependent constraints
+        bool singular = false;
+        for (size_t col = 0; col < n && !singular; col++) {
+            size_t pivot = col;
+            for (size_t r = col + 1; r < n; r++) {
+                if (fabs(K[r*max_size + col]) > fabs(K[pivot*max_size + col])) {
+                    pivot = r;
+                }
+            }
+            if (fabs(K[pivot*max_size + col]) < 1e-12) {
+                singular = true;
+                break;
+            }
+            for (size_t k = 0; k < n; k++) {
+                const double tmp = K[col*max_size + k];
+                K[col*max_size + k] = K[pivot*max_size + k];
+                K[pivot*max_size + k] = tmp;
+            }
+            const double tmp = rhs[col];
+            rhs[col] = rhs[pivot];
+            rhs[pivot] = tmp;
+            for (size_t r = col + 1; r < n; r++) {
+                const double f = K[r*max_size + col] / K[col*max_size + col];
+                for (size_t k = col; k < n; k++) {
+                    K[r*max_size + k] -= f * K[col*max_size + k];
+                }
+                rhs[r] -= f * rhs[col];
+            }
+        }
+        if (singular) {
+            continue;
+        }
+        double x[max_size] = {};
+        for (size_t l = n; l > 0; l--) {
+            const size_t r = l - 1;
+            double sum = rhs[r];
+            for (size_t k = r + 1; k < n; k++) {
+                sum -= K[r*max_size + k] * x[k];
+            }
+            x[r] = sum / K[r*max_size + r];
+        }
+
+        float u[8];
+        bool feasible = true;
+        for (size_t t = 0; t < h; t++) {
+            const double prev = t == 0 ? u_prev : x[t-1];
+            if (x[t] > up + 1e-6 || x[t] < lo - 1e-6 || fabs(x[t] - prev) > rate + 1e-6) {
+                feasible = false;
+            }
+            u[t] = static_cast<float>(x[t]);
+        }
+        if (feasible) {
+            const double cost = horizonCost(u, v, u_prev, h, w2);
+            best = cost < best ? cost : best;
+        }
+    }
+    return best;
+}
+
+bool isFeasible(const float u[], const float u_prev[], size_t n, size_t h, float lo, float up, float rate)
+{
+    for (size_t t = 0; t < h; t++) {
+        for (size_t j = 0; j < n; j++) {
+            const float prev = t == 0 ? u_prev[j] : u[(t-1)*n + j];
+            if (u[t*n + j] > up + 1e-5f || u[t*n + j] < lo - 1e-5f) {
+                printf("bound violated at %lu, %lu: %1.5f\n", t, j, u[t*n + j]);
+                return false;
+            }
+            if (fabs(u[t*n + j] - prev) > rate + 1e-5f) {
+                printf("rate violated at %lu, %lu: %1.5f\n", t, j, u[t*n + j] - prev);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
@@ -0,0 +1,214 @@
+#include "test_macros.hpp"
+#include "ifl_control/stdlib_imports.hpp"
+
+#include "ifl_control/IndiController.hpp"
+
+using namespace ifl_control;
+
+int test_increment_from_hover();
+int test_saturated_increment();
+int test_consecutive_ticks();
+int test_filtered_measurements();
+int test_effectiveness_adaptation();
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-4f);
+
+static const float B[] = {-20.0f, 20.0f, 20.0f, -20.0f,
+                          17.0f, -17.0f, 17.0f, -17.0f,
+                          0.7f, 0.7f, -0.7f, -0.7f,
+                          -1.2f, -1.2f, -1.2f, -1.2f
+                         };
+static const float Wv[] = {1000.0f, 1000.0f, 1.0f, 100.0f};
+static const float u_up[] = {1.0f, 1.0f, 1.0f, 1.0f};
+static const float u_lo[] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+int main()
+{
+    int ret = -1;
+
+    ret = test_increment_from_hover();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_saturated_increment();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_consecutive_ticks();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_filtered_measurements();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_effectiveness_adaptation();
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int test_increment_from_hover()
+{
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+
+    float u_f[] = {0.5f, 0.5f, 0.5f, 0.5f};
+    float accel_error[] = {10.0f, 0.0f, 0.0f, 0.0f};
+
+    float out[4] = {};
+    indi.update(accel_error, u_f, out, 10);
+    float expected_du[4] = {-0.125f, 0.125f, 0.125f, -0.125f};
+    float expected_out[4] = {0.375f, 0.625f, 0.625f, 0.375f};
+    TEST(isEqual(indi.getIncrement(), expected_du, 4));
+    TEST(isEqual(out, expected_out, 4));
+    return 0;
+}
+
+int test_saturated_increment()
+{
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+
+    // only 0.25 of headroom on every actuator, 20 of roll is available
+    float u_f[] = {0.75f, 0.25f, 0.25f, 0.75f};
+    float accel_error[] = {-100.0f, 0.0f, 0.0f, 0.0f};
+
+    float out[4] = {};
+    indi.update(accel_error, u_f, out, 10);
+    float expected_out[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+    TEST(isEqual(out, expected_out, 4));
+    return 0;
+}
+
+int test_consecutive_ticks()
+{
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+
+    float u_f[] = {0.5f, 0.5f, 0.5f, 0.5f};
+    float out[4] = {};
+
+    // saturate first
+    float big_error[] = {100.0f, 0.0f, 0.0f, 0.0f};
+    indi.update(big_error, u_f, out, 10);
+    float expected_saturated[4] = {0.0f, 1.0f, 1.0f, 0.0f};
+    TEST(isEqual(out, expected_saturated, 4));
+
+    // the constraints of the previous tick do not carry over
+    float small_error[] = {10.0f, 0.0f, 0.0f, 0.0f};
+    indi.update(small_error, u_f, out, 10);
+    float expected_out[4] = {0.375f, 0.625f, 0.625f, 0.375f};
+    TEST(isEqual(out, expected_out, 4));
+    return 0;
+}
+
+int test_filtered_measurements()
+{
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+    TEST(indi.setFilterLowPass(4000.0f, 40.0f) == 0);
+
+    float accel[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float u_meas[] = {0.5f, 0.5f, 0.5f, 0.5f};
+    indi.resetFilter(accel, u_meas);
+
+    // in steady state, the filtered signals equal the measurements
+    float accel_ref[] = {10.0f, 0.0f, 0.0f, 0.0f};
+    float out[4] = {};
+    indi.update(accel_ref, accel, u_meas, out, 10);
+    float expected_out[4] = {0.375f, 0.625f, 0.625f, 0.375f};
+    TEST(isEqual(out, expected_out, 4, 1e-3f));
+
+    // a step in the measurements is not passed on at once
+    float accel_step[] = {10.0f, 0.0f, 0.0f, 0.0f};
+    indi.update(accel_ref, accel_step, u_meas, out, 10);
+    for (size_t j = 0; j < 4; j++) {
+        TEST(fabs(out[j] - 0.5f) > 0.12f);
+    }
+    return 0;
+}
+
+int test_effectiveness_adaptation()
+{
+    // the controller starts with half the true effectiveness
+    float B_initial[16];
+    for (size_t l = 0; l < 16; l++) {
+        B_initial[l] = 0.5f * B[l];
+    }
+
+    IndiController<4,4> indi;
+    indi.setActuatorEffectiveness(B_initial);
+    indi.setOutputWeights(Wv);
+    indi.setActuatorUpperLimit(u_up);
+    indi.setActuatorLowerLimit(u_lo);
+    TEST(indi.setFilterLowPass(4000.0f, 100.0f) == 0);
+    float mu[] = {0.2f, 0.2f, 0.2f, 0.2f};
+    TEST(indi.setEffectivenessLearningRate(mu) == 0);
+
+    float u_meas[] = {0.5f, 0.5f, 0.5f, 0.5f};
+    float accel[4] = {};
+    indi.resetFilter(accel, u_meas);
+
+    float out[4] = {};
+    for (size_t k = 0; k < 4000; k++) {
+        // static plant, perfect actuators
+        for (size_t i = 0; i < 4; i++) {
+            accel[i] = 0.0f;
+            for (size_t j = 0; j < 4; j++) {
+                accel[i] += B[i*4 + j] * (u_meas[j] - 0.5f);
+            }
+        }
+        float t = static_cast<float>(k);
+        float accel_ref[] = {3.0f * sin(0.05f * t), 3.0f * sin(0.031f * t), 0.1f * sin(0.023f * t), 0.2f * sin(0.017f * t)};
+        indi.update(accel_ref, accel, u_meas, out, 10);
+        for (size_t j = 0; j < 4; j++) {
+            u_meas[j] = out[j];
+        }
+    }
+
+    const float *B_estimate = indi.getActuatorEffectiveness();
+    for (size_t l = 0; l < 16; l++) {
+        TEST(fabs(B_estimate[l] - B[(l%4)*4 + l/4]) < 0.05f * fabs(B[(l%4)*4 + l/4]));
+    }
+    return 0;
+}
+
+bool isEqual(const float actual[], const float expected[], size_t len, float eps)
+{
+    bool equal = true;
+    for (size_t i = 0; i < len; i++) {
+        if (fabs(actual[i] - expected[i]) > eps) {
+            equal = false;
+            break;
+        }
+    }
+
+    if (!equal) {
+        printf("not equal!\n");
+        printf("index\tactual\texpected\n");
+        for (size_t i = 0; i < len; i++) {
+            printf("%lu\t%1.5f\t%1.5f\n", i, actual[i], expected[i]);
+        }
+    }
+
+    return equal;
+}
@@ -8,6 +8,9 @@ using namespace ifl_control;
 int test_4x3();
 int test_4x4();
 int test_div_zero();
+int test_sparse_4x3();
+int test_rank_deficient_4x3();
+int test_pivoted_2x3();
 
 void to_column_major(const float data_row_major[], size_t rows, size_t columns, float data[]);
 bool isEqual(const float actual[], const float expected[], size_t len, float eps = 1e-6f);
@@ -31,6 +34,21 @@ int main()
         return ret;
     }
 
+    ret = test_sparse_4x3();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_rank_deficient_4x3();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = test_pivoted_2x3();
+    if (ret < 0) {
+        return ret;
+    }
+
     return 0;
 }
 
@@ -122,6 +140,139 @@ int test_div_zero() {
     return 0;
 }
 
+int test_sparse_4x3()
+{
+    const size_t m = 4;
+    const size_t n = 3;
+    const float data_row_major[m*n] = { 20.f,   0.f, -13.f,
+                                        0.f,  16.f, -18.f,
+                                        0.7f,   0.f,   0.9f,
+                                        0.f,  -1.1f,   0.f
+                                      };
+
+    float A_dense[m*n];
+    float A_sparse[m*n];
+    float tau[m];
+    float w[m];
+
+    to_column_major(data_row_major, m, n, A_dense);
+    to_column_major(data_row_major, m, n, A_sparse);
+    float b[m] = {2.0f, 3.0f, 4.0f, 5.0f};
+
+    LeastSquaresSolver solver;
+    solver.setMatrix(A_dense, tau, w, m, n);
+    float x_dense[m] = {};
+    solver.solve(b, x_dense);
+
+    // rows 0 and 2, rows 1 and 3, rows 0, 1 and 2
+    uint32_t pattern[n] = {0x5, 0xA, 0x7};
+    TEST(solver.setMatrix(A_sparse, tau, w, m, n, pattern) == 0);
+    float x_sparse[m] = {};
+    solver.solve(b, x_sparse);
+    TEST(isEqual(x_sparse, x_dense, n, 1e-5f));
+
+    // the decomposition fills in the pattern
+    TEST(pattern[0] == 0x5);
+    TEST(pattern[1] == 0xA);
+    TEST(pattern[2] == 0xF);
+
+    // patterns are limited in the number of rows
+    TEST(solver.setMatrix(A_sparse, tau, w, 33, n, pattern) < 0);
+
+    return 0;
+}
+
+int test_rank_deficient_4x3()
+{
+    const size_t m = 4;
+    const size_t n = 3;
+    // the last column is twice the first
+    const float data_row_major[m*n] = { 20.f, -10.f,  40.f,
+                                        17.f,  16.f,  34.f,
+                                        0.7f,  -0.8f,  1.4f,
+                                        -1.f,  -1.1f,  -2.f
+                                      };
+
+    float A[m*n];
+    float tau[2*n];
+    float w[m];
+    size_t perm[n];
+
+    to_column_major(data_row_major, m, n, A);
+    float b[m] = {2.0f, 3.0f, 4.0f, 5.0f};
+
+    LeastSquaresSolver solver;
+    TEST(solver.setMatrixPivoted(A, tau, w, perm, m, n) == 0);
+    TEST(solver.getRank() == 2);
+    float x[m] = {};
+    solver.solve(b, x);
+
+    // same fit as the independent columns alone
+    const float reduced_row_major[m*2] = { -10.f,  40.f,
+                                            16.f,  34.f,
+                                            -0.8f,  1.4f,
+                                            -1.1f,  -2.f
+                                         };
+    float A_reduced[m*2];
+    to_column_major(reduced_row_major, m, 2, A_reduced);
+    float x_reduced[m] = {};
+    solver.setMatrix(A_reduced, tau, w, m, 2);
+    solver.solve(b, x_reduced);
+
+    float fit[m] = {};
+    float fit_reduced[m] = {};
+    to_column_major(data_row_major, m, n, A);
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            fit[i] += A[j*m + i] * x[j];
+        }
+        fit_reduced[i] = A[1*m + i] * x_reduced[0] + A[2*m + i] * x_reduced[1];
+    }
+    TEST(isEqual(fit, fit_reduced, m, 1e-4f));
+
+    // minimum norm, the collinear columns share the effort
+    TEST(fabs(x[2] - 2.0f * x[0]) < 1e-4f);
+
+    return 0;
+}
+
+int test_pivoted_2x3()
+{
+    const size_t m = 2;
+    const size_t n = 3;
+    const float data_row_major[m*n] = { 1.0f, -1.0f, 0.5f,
+                                        0.0f,  1.0f, 4.0f
+                                      };
+
+    float A[m*n];
+    float tau[2*m];
+    float w[n];
+    size_t perm[n];
+
+    to_column_major(data_row_major, m, n, A);
+    float b[m] = {1.0f, 2.0f};
+
+    LeastSquaresSolver solver;
+    TEST(solver.setMatrixPivoted(A, tau, w, perm, m, n) == 0);
+    TEST(solver.getRank() == 2);
+    float x[n] = {};
+    solver.solve(b, x);
+
+    // more columns than rows, the system is solved exactly
+    to_column_major(data_row_major, m, n, A);
+    float Ax[m] = {};
+    for (size_t l = 0; l < m*n; l++) {
+        Ax[l%m] += A[l] * x[l/m];
+    }
+    TEST(isEqual(Ax, b, m, 1e-5f));
+
+    // and it is the solution with the smallest norm, A^T * (A * A^T)^-1 * b
+    float x_check[n] = {0.40268456f, -0.30872483f, 0.57718121f};
+    TEST(isEqual(x, x_check, n, 1e-5f));
+
+    return 0;
+}
+
 bool isEqual(const float actual[], const float expected[], size_t len, float eps)
 {
     bool equal = true;
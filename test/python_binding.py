@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+"""Test of the Python binding against results of the C++ ActiveSetAlgorithm.
+
+Run by CTest with IFL_CONTROL_LIBRARY and PYTHONPATH set. Exits with 77,
+which CTest reports as skipped, when NumPy is not installed.
+"""
+
+import sys
+
+try:
+    import numpy as np
+except ImportError:
+    print('NumPy is not available, skipping')
+    sys.exit(77)
+
+import ifl_control
+
+B = np.array([[-20.0,  20.0, 20.0, -20.0],   # Roll
+              [ 17.0, -17.0, 17.0, -17.0],   # Pitch
+              [  0.7,   0.7, -0.7,  -0.7],   # Yaw
+              [ -1.2,  -1.2, -1.2,  -1.2]])  # Thrust
+Wv = [1000.0, 1000.0, 1.0, 100.0]
+u_up = [1.0, 1.0, 1.0, 1.0]
+u_lo = [-1.0, -1.0, -1.0, -1.0]
+
+# requests and expected commands of test/active_set_algorithm.cpp
+v = np.array([[10.0, 0.0, 0.0, 0.0],    # just roll
+              [100.0, 0.0, 0.0, 0.0],   # too much roll
+              [20.0, 0.0, 5.0, 0.0]])   # some roll and too much yaw
+expected = np.array([[-0.125, 0.125, 0.125, -0.125],
+                     [-1.0, 1.0, 1.0, -1.0],
+                     [0.5, 1.0, -0.5, -1.0]])
+
+
+def test_batch():
+    u, status, iterations = ifl_control.allocate(B, Wv, v, u_lo, u_up)
+    assert u.dtype == np.float32 and u.shape == (3, 4)
+    assert np.allclose(u, expected, atol=1e-4), u
+    assert np.all(status == ifl_control.CONVERGED), status
+    assert np.all(iterations > 0), iterations
+
+
+def test_hexacopter():
+    # more actuators than outputs, as test_hexacopter_thrust
+    B_hexa = [[-10.0, -20.0, -10.0, 10.0, 20.0, 10.0],
+              [14.7, 0.0, -14.7, -14.7, 0.0, 14.7],
+              [0.7, -0.7, 0.7, -0.7, 0.7, -0.7],
+              [-1.2, -1.2, -1.2, -1.2, -1.2, -1.2]]
+    u, status, _ = ifl_control.allocate(B_hexa, Wv, [0.0, 0.0, 0.0, -3.6], np.zeros(6), np.ones(6))
+    assert np.allclose(u, 0.5, atol=1e-4), u
+    assert status[0] == ifl_control.CONVERGED
+
+
+def test_strides():
+    # reversed rows have a negative stride, they must be copied
+    u, _, _ = ifl_control.allocate(B, Wv, v[::-1], u_lo, u_up)
+    assert np.allclose(u, expected[::-1], atol=1e-4), u
+
+    # every other row of a larger array, passed with its stride
+    v_spaced = np.zeros((6, 4), dtype=np.float32)
+    v_spaced[::2] = v
+    u, _, _ = ifl_control.allocate(B, Wv, v_spaced[::2], u_lo, u_up)
+    assert np.allclose(u, expected, atol=1e-4), u
+
+    # a row stride that is not a multiple of the element size
+    raw = np.zeros(3 * 18, dtype=np.uint8)
+    v_packed = np.ndarray((3, 4), dtype=np.float32, buffer=raw, strides=(18, 4))
+    v_packed[:] = v
+    u, _, _ = ifl_control.allocate(B, Wv, v_packed, u_lo, u_up)
+    assert np.allclose(u, expected, atol=1e-4), u
+
+    # broadcast bounds have a zero stride and are shared
+    u_up_broadcast = np.broadcast_to(np.array(u_up, dtype=np.float32), (3, 4))
+    u, _, _ = ifl_control.allocate(B, Wv, v, u_lo, u_up_broadcast)
+    assert np.allclose(u, expected, atol=1e-4), u
+
+
+def test_invalid_shape():
+    try:
+        ifl_control.allocate(B, Wv, v, u_lo[:3], u_up)
+    except ValueError:
+        return
+    assert False, 'ValueError expected'
+
+
+if __name__ == '__main__':
+    test_batch()
+    test_hexacopter()
+    test_strides()
+    test_invalid_shape()
+    print('Python binding passed')